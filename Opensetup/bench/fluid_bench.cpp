@@ -0,0 +1,356 @@
+#include "FluidSimulation.h"
+#include "GpuProfiler.h"
+#include "HeadlessContext.h"
+#include "ShaderCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Standalone benchmark: runs scripted scenarios on the GPU solver across a
+// sweep of grid sizes, pressure iteration counts and storage precisions in
+// a headless context, and writes steps/s, GPU time per pass and field memory
+// as JSON for tracking regressions and sizing hardware.
+
+enum class Scenario {
+    Vortex,     // the solver's initial vortex, no forcing
+    Jets,       // still start, three emitters pushing dye in every step
+    Storm       // still start, a burst of random splats every step
+};
+
+struct BenchOptions {
+    std::vector<Scenario> scenarios = { Scenario::Vortex, Scenario::Jets, Scenario::Storm };
+    std::vector<int> grids = { 128, 256, 512, 1024, 2048, 4096 };
+    std::vector<int> iterations = { 20, 40 };
+    std::vector<FieldPrecision> precisions = { FieldPrecision::Full, FieldPrecision::Half, FieldPrecision::Packed };
+    int warmupSteps = 10;
+    int steps = 100;
+    int profileSteps = 20;
+    double maxRunSeconds = 30.0;   // a run stops early past this, e.g. 4096² on a small GPU
+    std::string output = "fluid_bench.json";
+    std::string shaderCache;        // empty disables the program binary cache
+};
+
+struct PassResult {
+    std::string name;
+    double minMs;
+    double meanMs;
+    double p99Ms;
+};
+
+struct RunResult {
+    Scenario scenario;
+    int grid;
+    int iterations;
+    FieldPrecision precision;
+    std::string error;      // empty when the run completed
+    int steps = 0;
+    double seconds = 0.0;
+    size_t fieldMemory = 0;
+    std::vector<PassResult> passes;
+};
+
+static const char* scenarioName(Scenario scenario) {
+    switch (scenario) {
+    case Scenario::Jets: return "jets";
+    case Scenario::Storm: return "storm";
+    default: return "vortex";
+    }
+}
+
+static const char* precisionName(FieldPrecision precision) {
+    switch (precision) {
+    case FieldPrecision::Half: return "half";
+    case FieldPrecision::Packed: return "packed";
+    default: return "full";
+    }
+}
+
+static bool parseScenario(const std::string& name, Scenario& scenario) {
+    if (name == "vortex") scenario = Scenario::Vortex;
+    else if (name == "jets") scenario = Scenario::Jets;
+    else if (name == "storm") scenario = Scenario::Storm;
+    else return false;
+    return true;
+}
+
+static bool parsePrecision(const std::string& name, FieldPrecision& precision) {
+    if (name == "full") precision = FieldPrecision::Full;
+    else if (name == "half") precision = FieldPrecision::Half;
+    else if (name == "packed") precision = FieldPrecision::Packed;
+    else return false;
+    return true;
+}
+
+static std::vector<std::string> splitList(const char* text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// Queues the scenario's forcing for one step. The random storm is seeded
+// per run, so every configuration sees the same splats.
+static void applyScenario(FluidSimulation& sim, Scenario scenario, std::mt19937& random) {
+    if (scenario == Scenario::Jets) {
+        struct Jet { float x, y, fx, fy, r, g, b; };
+        const Jet jets[] = {
+            { 0.1f, 0.5f, 0.2f, 0.0f, 0.8f, 0.2f, 0.1f },
+            { 0.9f, 0.45f, -0.2f, 0.0f, 0.1f, 0.3f, 0.8f },
+            { 0.5f, 0.1f, 0.0f, 0.2f, 0.2f, 0.8f, 0.3f } };
+        for (const Jet& jet : jets) {
+            sim.queueForce(FluidSimulation::forceSplat(jet.x, jet.y, jet.fx, jet.fy));
+            sim.queueDye(FluidSimulation::dyeSplat(jet.x, jet.y, jet.r, jet.g, jet.b));
+        }
+    }
+    else if (scenario == Scenario::Storm) {
+        const int splatsPerStep = 32;
+        const float pi = 3.14159265f;
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (int i = 0; i < splatsPerStep; i++) {
+            float x = unit(random);
+            float y = unit(random);
+            float angle = unit(random) * 2.0f * pi;
+            float force = 0.1f + 0.2f * unit(random);
+            sim.queueForce(FluidSimulation::forceSplat(x, y, force * std::cos(angle), force * std::sin(angle)));
+            sim.queueDye(FluidSimulation::dyeSplat(x, y, unit(random), unit(random), unit(random)));
+        }
+    }
+}
+
+static RunResult runConfiguration(const BenchOptions& options, Scenario scenario, int grid, int iterations,
+    FieldPrecision precision) {
+    RunResult result;
+    result.scenario = scenario;
+    result.grid = grid;
+    result.iterations = iterations;
+    result.precision = precision;
+
+    while (glGetError() != GL_NO_ERROR) {}
+    FluidSimulation sim(grid, grid);
+    sim.setFieldPrecision(precision);
+    sim.setPressureIterations(iterations);
+    sim.init();
+    if (scenario != Scenario::Vortex) sim.clearFields();
+    sim.finish();
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        result.error = "out of memory";
+        return result;
+    }
+    result.fieldMemory = sim.getFieldMemory();
+
+    const float dt = 0.016f;
+    std::mt19937 random(1);
+    for (int i = 0; i < options.warmupSteps; i++) {
+        applyScenario(sim, scenario, random);
+        sim.step(dt);
+    }
+    sim.finish();
+
+    // Steps/s is measured without timer queries in the way
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.steps; i++) {
+        applyScenario(sim, scenario, random);
+        sim.step(dt);
+        result.steps++;
+        // Checked every few steps, so the fence does not pace the pipeline
+        if ((i & 7) == 7) {
+            sim.finish();
+            if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > options.maxRunSeconds) break;
+        }
+    }
+    sim.finish();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    GpuProfiler profiler;
+    sim.setProfiler(&profiler);
+    int profileSteps = result.steps < options.steps ? std::min(options.profileSteps, 2) : options.profileSteps;
+    for (int i = 0; i < profileSteps; i++) {
+        profiler.beginFrame();
+        applyScenario(sim, scenario, random);
+        sim.step(dt);
+        profiler.endFrame();
+    }
+    sim.finish();
+    profiler.collect();
+    sim.setProfiler(nullptr);
+    for (const GpuProfiler::PassStats& stats : profiler.getStats()) {
+        PassResult pass;
+        pass.name = stats.name;
+        pass.minMs = stats.minMs;
+        pass.meanMs = stats.meanMs;
+        pass.p99Ms = stats.p99Ms;
+        result.passes.push_back(pass);
+    }
+
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        result.error = "out of memory";
+    }
+    return result;
+}
+
+static void writeJsonString(std::ostream& out, const std::string& text) {
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') out << '\\';
+        if ((unsigned char)c >= 0x20) out << c;
+    }
+    out << '"';
+}
+
+static void writeJson(std::ostream& out, const BenchOptions& options, const std::vector<RunResult>& results) {
+    out << "{\n  \"renderer\": ";
+    writeJsonString(out, (const char*)glGetString(GL_RENDERER));
+    out << ",\n  \"version\": ";
+    writeJsonString(out, (const char*)glGetString(GL_VERSION));
+    out << ",\n  \"warmup_steps\": " << options.warmupSteps
+        << ",\n  \"steps\": " << options.steps
+        << ",\n  \"profile_steps\": " << options.profileSteps
+        << ",\n  \"runs\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const RunResult& run = results[i];
+        out << (i > 0 ? "," : "") << "\n    {\"scenario\": \"" << scenarioName(run.scenario) << "\", \"grid\": " << run.grid
+            << ", \"pressure_iterations\": " << run.iterations << ", \"precision\": \"" << precisionName(run.precision) << "\"";
+        if (!run.error.empty()) {
+            out << ", \"error\": ";
+            writeJsonString(out, run.error);
+        }
+        out << ", \"steps\": " << run.steps << ", \"seconds\": " << run.seconds
+            << ", \"steps_per_second\": " << (run.seconds > 0.0 ? run.steps / run.seconds : 0.0)
+            << ", \"field_memory_bytes\": " << run.fieldMemory << ",\n     \"passes\": {";
+        for (size_t j = 0; j < run.passes.size(); j++) {
+            const PassResult& pass = run.passes[j];
+            out << (j > 0 ? ", " : "");
+            writeJsonString(out, pass.name);
+            out << ": {\"min_ms\": " << pass.minMs << ", \"mean_ms\": " << pass.meanMs << ", \"p99_ms\": " << pass.p99Ms << "}";
+        }
+        out << "}}";
+    }
+    out << "\n  ]\n}" << std::endl;
+}
+
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program
+        << " [--scenarios vortex,jets,storm] [--grids 128,256,...] [--iterations 20,40]"
+        << " [--precisions full,half,packed] [--steps N] [--warmup N] [--profile-steps N]"
+        << " [--max-run-seconds S] [--output FILE] [--shader-cache DIR | --no-shader-cache]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--scenarios") == 0 && hasValue) {
+            options.scenarios.clear();
+            for (const std::string& name : splitList(argv[++i])) {
+                Scenario scenario;
+                if (!parseScenario(name, scenario)) {
+                    std::cout << "Unknown scenario: " << name << std::endl;
+                    return -1;
+                }
+                options.scenarios.push_back(scenario);
+            }
+        }
+        else if (strcmp(argv[i], "--grids") == 0 && hasValue) {
+            options.grids.clear();
+            for (const std::string& size : splitList(argv[++i])) {
+                options.grids.push_back(atoi(size.c_str()));
+            }
+        }
+        else if (strcmp(argv[i], "--iterations") == 0 && hasValue) {
+            options.iterations.clear();
+            for (const std::string& count : splitList(argv[++i])) {
+                options.iterations.push_back(atoi(count.c_str()));
+            }
+        }
+        else if (strcmp(argv[i], "--precisions") == 0 && hasValue) {
+            options.precisions.clear();
+            for (const std::string& name : splitList(argv[++i])) {
+                FieldPrecision precision;
+                if (!parsePrecision(name, precision)) {
+                    std::cout << "Unknown precision: " << name << std::endl;
+                    return -1;
+                }
+                options.precisions.push_back(precision);
+            }
+        }
+        else if (strcmp(argv[i], "--steps") == 0 && hasValue) {
+            options.steps = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--warmup") == 0 && hasValue) {
+            options.warmupSteps = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--profile-steps") == 0 && hasValue) {
+            options.profileSteps = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--max-run-seconds") == 0 && hasValue) {
+            options.maxRunSeconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--output") == 0 && hasValue) {
+            options.output = argv[++i];
+        }
+        else if (strcmp(argv[i], "--shader-cache") == 0 && hasValue) {
+            options.shaderCache = argv[++i];
+        }
+        else if (strcmp(argv[i], "--no-shader-cache") == 0) {
+            options.shaderCache.clear();
+        }
+        else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    for (int grid : options.grids) {
+        if (grid <= 0) {
+            std::cout << "Grid sizes must be positive" << std::endl;
+            return -1;
+        }
+    }
+
+    ShaderCache::setDirectory(options.shaderCache);
+    HeadlessContext context;
+    if (!context.initialize()) {
+        std::cout << "Failed to create headless context" << std::endl;
+        return -1;
+    }
+
+    std::vector<RunResult> results;
+    for (Scenario scenario : options.scenarios) {
+        for (int grid : options.grids) {
+            for (int iterations : options.iterations) {
+                for (FieldPrecision precision : options.precisions) {
+                    RunResult run = runConfiguration(options, scenario, grid, iterations, precision);
+                    std::cout << scenarioName(scenario) << " " << grid << "x" << grid << ", " << iterations
+                        << " iterations, " << precisionName(precision) << ": ";
+                    if (!run.error.empty()) {
+                        std::cout << run.error << std::endl;
+                    }
+                    else {
+                        std::cout << (run.seconds > 0.0 ? run.steps / run.seconds : 0.0) << " steps/s" << std::endl;
+                    }
+                    results.push_back(run);
+                }
+            }
+        }
+    }
+
+    std::ofstream out(options.output);
+    if (!out) {
+        std::cout << "Could not write " << options.output << std::endl;
+        return -1;
+    }
+    writeJson(out, options, results);
+    std::cout << "Wrote " << results.size() << " runs to " << options.output << std::endl;
+    return 0;
+}
\ No newline at end of file
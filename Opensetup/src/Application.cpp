@@ -1,4 +1,6 @@
 #include "Application.h"
+#include "GLExtensions.h"
+#include "Trace.h"
 #include <glad/glad.h>
 #include <iostream>
 #include <algorithm>
@@ -6,7 +8,8 @@
 
 Application::Application(int width, int height, const char* title)
     : windowWidth(width), windowHeight(height), windowTitle(title),
-    window(nullptr), lastTime(0.0), fpsTime(0.0), frameCount(0) {
+    window(nullptr), fusedPasses(false), simulationRate(60.0), courantNumber(0.0f), dyeResolution(0), gridSize(512), fieldPrecision(FieldPrecision::Full), stepBudget(0.0), profiling(false), startTime(0.0), traceKeyDown(false), lastTime(0.0), frameBudget(1000.0 / 60.0), reportTime(0.0),
+    strokeActive(false), strokeEnd(), strokeCarry(0.0f) {
 }
 
 Application::~Application() {
@@ -22,11 +25,17 @@ bool Application::initialize() {
         return false;
     }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    // Ask for 4.3 so the compute-shader path is available, then settle for 3.3
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     window = glfwCreateWindow(windowWidth, windowHeight, windowTitle, NULL, NULL);
+    if (!window) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(windowWidth, windowHeight, windowTitle, NULL, NULL);
+    }
     if (!window) {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -40,82 +49,256 @@ bool Application::initialize() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return false;
     }
+    GLExtensions::load((GLADloadproc)glfwGetProcAddress);
 
     // Create input handler and set up callbacks
     inputHandler = std::make_unique<InputHandler>();
     inputHandler->setWindow(window);
 
     // Create and initialize fluid simulation
-    fluidSim = std::make_unique<FluidSimulation>(512, 512);
+    fluidSim = std::make_unique<FluidSimulation>(gridSize, gridSize);
+    fluidSim->setPressureOptions(pressureOptions);
+    fluidSim->setFusedPasses(fusedPasses);
+    fluidSim->setVelocityMonitoring(courantNumber > 0.0f);
+    fluidSim->setDyeResolution(dyeResolution, dyeResolution);
+    fluidSim->setFieldPrecision(fieldPrecision);
+    fluidSim->setSparseSettings(sparseSettings);
     fluidSim->init();
+    clock.setRate(simulationRate);
+
+    frameStats.setBudget(frameBudget);
+    if (!frameCsvPath.empty() && !frameStats.openCsv(frameCsvPath)) {
+        std::cout << "Could not open " << frameCsvPath << std::endl;
+        return false;
+    }
+
+    if (stepBudget > 0.0) {
+        ResolutionSettings settings;
+        settings.budgetMs = stepBudget;
+        resolutionController = std::make_unique<ResolutionController>();
+        resolutionController->setSettings(settings);
+    }
+
+    if (profiling) {
+        profiler = std::make_unique<GpuProfiler>();
+        fluidSim->setProfiler(profiler.get());
+        if (!profileCsvPath.empty()) {
+            profileCsv.open(profileCsvPath);
+            if (!profileCsv) {
+                std::cout << "Could not open " << profileCsvPath << std::endl;
+                return false;
+            }
+            GpuProfiler::writeCsvHeader(profileCsv);
+        }
+    }
 
     lastTime = glfwGetTime();
-    fpsTime = lastTime;
+    reportTime = lastTime;
+    startTime = lastTime;
 
     return true;
 }
 
+namespace {
+    // Splat spacing along a stroke in units of the dye splat's e-folding
+    // distance, sqrt(radius) texels
+    const float strokeSpacing = 1.0f;
+    // Force per splat for a stroke moving at one window per second
+    const float strokeForce = 0.1f;
+    // Keeps a flick across a large grid within a few splat batches
+    const int maxStrokeSplats = 1024;
+}
+
 void Application::run() {
+    bool previousFrame = false;
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        TRACE_ZONE("frame");
+        {
+            TRACE_ZONE("poll events");
+            glfwPollEvents();
+        }
+        if (Trace::enabled) {
+            // T writes the trace so far
+            bool traceKey = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+            if (traceKey && !traceKeyDown) Trace::write();
+            traceKeyDown = traceKey;
+        }
 
         double currentTime = glfwGetTime();
-        float dt = (float)(currentTime - lastTime);
+        double elapsed = currentTime - lastTime;
         lastTime = currentTime;
 
-        updateFPS();
-
-        // Clamp dt to prevent instability
-        dt = std::min(dt, 0.016f);
-
-        processInput(dt);
+        // The previous frame ends here, swap included
+        if (previousFrame) {
+            frameSample.frameMs = elapsed * 1000.0;
+            frameStats.record(frameSample);
+        }
+        previousFrame = true;
+        reportFrameStats();
+        if (profiler) profiler->beginFrame();
 
-        // Step simulation
-        fluidSim->step(dt);
+        if (courantNumber > 0.0f) {
+            // Until the first max |u| arrives the fixed rate is used
+            float stable = fluidSim->getStableTimestep(courantNumber);
+            if (stable > 0.0f) {
+                clock.setAdaptiveStep(stable);
+            }
+        }
+        int substeps = clock.advance(elapsed);
+        // Input is drained once per frame and lands in the first substep
+        processInput((float)elapsed, substeps > 0);
+        if (resolutionController) resolutionController->begin();
+        double stepStart = glfwGetTime();
+        {
+            TRACE_ZONE("steps");
+            for (int i = 0; i < substeps; i++) {
+                fluidSim->step(clock.getStep());
+            }
+        }
+        frameSample.stepMs = (glfwGetTime() - stepStart) * 1000.0;
+        frameSample.steps = substeps;
+        if (resolutionController) {
+            resolutionController->end(substeps);
+            updateResolution();
+        }
 
         // Render
         int winWidth, winHeight;
         glfwGetWindowSize(window, &winWidth, &winHeight);
-        fluidSim->render(winWidth, winHeight);
+        double renderStart = glfwGetTime();
+        {
+            TRACE_ZONE("render");
+            fluidSim->render(winWidth, winHeight, clock.getInterpolation());
+        }
+        frameSample.renderMs = (glfwGetTime() - renderStart) * 1000.0;
+        if (profiler) profiler->endFrame();
 
+        // Blocks here when the driver is frames ahead or waiting on vsync
+        TRACE_ZONE("swap buffers");
         glfwSwapBuffers(window);
     }
+    frameStats.reportTotal(std::cout);
 }
 
-void Application::processInput(float dt) {
-    if (inputHandler->isMouseDown()) {
-        int winWidth, winHeight;
-        glfwGetWindowSize(window, &winWidth, &winHeight);
+void Application::processInput(float dt, bool stepping) {
+    TRACE_ZONE("process input");
+    cursorEvents.clear();
+    inputHandler->drainEvents(cursorEvents);
+    glfwGetWindowSize(window, &windowWidth, &windowHeight);
 
-        float x = (float)inputHandler->getMouseX() / winWidth;
-        float y = 1.0f - (float)inputHandler->getMouseY() / winHeight;
+    if (cursorEvents.empty()) {
+        // Holding still keeps feeding dye, one splat per frame that steps so
+        // the amount follows the simulation rate rather than the frame rate
+        if (strokeActive && stepping) {
+            float x = (float)strokeEnd.x / std::max(windowWidth, 1);
+            float y = 1.0f - (float)strokeEnd.y / std::max(windowHeight, 1);
+            strokeSplat(x, y, 0.0f, 0.0f, glfwGetTime());
+        }
+        return;
+    }
 
-        float dx = (float)inputHandler->getMouseDeltaX() / winWidth;
-        float dy = -(float)inputHandler->getMouseDeltaY() / winHeight;
+    // glfwPollEvents() hands the callbacks a frame's events in one burst, so
+    // their timestamps order the samples but are too close together for
+    // per-segment speeds. The speed is averaged over the frame instead, and
+    // each segment pushes along its own direction.
+    double length = 0.0;
+    double startTime = strokeActive ? strokeEnd.time : cursorEvents.front().time;
+    double endTime = startTime;
+    bool active = strokeActive;
+    CursorEvent last = strokeEnd;
+    for (const CursorEvent& event : cursorEvents) {
+        if (event.type == CursorEvent::Press) {
+            if (!active) startTime = event.time;
+            active = true;
+        }
+        else if (active) {
+            double dx = (event.x - last.x) / std::max(windowWidth, 1);
+            double dy = (event.y - last.y) / std::max(windowHeight, 1);
+            length += std::sqrt(dx * dx + dy * dy);
+            endTime = event.time;
+            if (event.type == CursorEvent::Release) active = false;
+        }
+        last = event;
+    }
+    float speed = (float)(length / std::max(endTime - startTime, (double)dt));
+    float force = speed * strokeForce;
+
+    for (const CursorEvent& event : cursorEvents) {
+        if (event.type == CursorEvent::Press) {
+            strokeActive = true;
+            strokeCarry = 0.0f;
+            float x = (float)event.x / std::max(windowWidth, 1);
+            float y = 1.0f - (float)event.y / std::max(windowHeight, 1);
+            strokeSplat(x, y, 0.0f, 0.0f, event.time);
+        }
+        else if (strokeActive) {
+            strokeSegment(strokeEnd, event, force);
+            if (event.type == CursorEvent::Release) strokeActive = false;
+        }
+        strokeEnd = event;
+    }
+}
 
-        // Add force based on mouse movement
-        fluidSim->addForce(x, y, dx * 10.0f, dy * 10.0f);
+void Application::strokeSegment(const CursorEvent& from, const CursorEvent& to, float force) {
+    int gridW = fluidSim->getWidth();
+    int gridH = fluidSim->getHeight();
 
-        // Add colorful dye
-        float time = (float)glfwGetTime();
-        float r = 0.5f + 0.5f * sin(time * 2.0f);
-        float g = 0.5f + 0.5f * sin(time * 3.0f + 1.0f);
-        float b = 0.5f + 0.5f * sin(time * 4.0f + 2.0f);
+    // Walk the segment in simulation texels so the spacing matches the
+    // splat footprint whatever the window size
+    float x0 = (float)from.x / std::max(windowWidth, 1);
+    float y0 = 1.0f - (float)from.y / std::max(windowHeight, 1);
+    float x1 = (float)to.x / std::max(windowWidth, 1);
+    float y1 = 1.0f - (float)to.y / std::max(windowHeight, 1);
+    float dx = (x1 - x0) * gridW;
+    float dy = (y1 - y0) * gridH;
+    float length = std::sqrt(dx * dx + dy * dy);
+    if (length <= 0.0f) return;
 
-        fluidSim->addDye(x, y, r * 0.8f, g * 0.8f, b * 0.8f);
+    Splat reference = FluidSimulation::dyeSplat(0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    float spacing = strokeSpacing * std::sqrt(reference.radius);
+    spacing = std::max(spacing, length / maxStrokeSplats);
+
+    float fx = force * dx / length;
+    float fy = force * dy / length;
+    float distance = spacing - strokeCarry;
+    for (; distance <= length; distance += spacing) {
+        float t = distance / length;
+        strokeSplat(x0 + (x1 - x0) * t, y0 + (y1 - y0) * t, fx, fy,
+            from.time + (to.time - from.time) * t);
+    }
+    strokeCarry = length - (distance - spacing);
+}
+
+void Application::strokeSplat(float x, float y, float fx, float fy, double time) {
+    // Colour cycles with the event time, so it also varies along a stroke
+    float r = 0.5f + 0.5f * (float)sin(time * 2.0);
+    float g = 0.5f + 0.5f * (float)sin(time * 3.0 + 1.0);
+    float b = 0.5f + 0.5f * (float)sin(time * 4.0 + 2.0);
+
+    fluidSim->queueForce(FluidSimulation::forceSplat(x, y, fx, fy));
+    fluidSim->queueDye(FluidSimulation::dyeSplat(x, y, r * 0.8f, g * 0.8f, b * 0.8f));
+}
 
-        inputHandler->update();
+void Application::updateResolution() {
+    int width, height;
+    if (resolutionController->update(fluidSim->getWidth(), fluidSim->getHeight(), width, height)) {
+        std::cout << "Step time " << resolutionController->getAverageStepMs() << " ms, grid "
+            << fluidSim->getWidth() << "x" << fluidSim->getHeight() << " -> " << width << "x" << height << std::endl;
+        fluidSim->resize(width, height);
     }
 }
 
-void Application::updateFPS() {
-    frameCount++;
+void Application::reportFrameStats() {
     double currentTime = glfwGetTime();
-    if (currentTime - fpsTime >= 1.0) {
-        double fps = frameCount / (currentTime - fpsTime);
-        std::cout << "FPS: " << (int)fps << " | Frame time: " << (1000.0 / fps) << "ms" << std::endl;
-        frameCount = 0;
-        fpsTime = currentTime;
+    if (currentTime - reportTime >= 1.0) {
+        frameStats.report(std::cout, currentTime - reportTime);
+        std::cout << "  grid " << fluidSim->getWidth() << "x" << fluidSim->getHeight()
+            << ", pressure iterations " << fluidSim->getLastPressureIterations() << std::endl;
+        if (profiler) {
+            profiler->print(std::cout);
+            if (profileCsv.is_open()) profiler->writeCsv(profileCsv, currentTime - startTime);
+        }
+        reportTime = currentTime;
     }
 }
 
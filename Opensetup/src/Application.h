@@ -3,8 +3,15 @@
 
 #include "FluidSimulation.h"
 #include "InputHandler.h"
+#include "SimulationClock.h"
+#include "ResolutionController.h"
+#include "GpuProfiler.h"
+#include "FrameStats.h"
 #include <GLFW/glfw3.h>
+#include <fstream>
 #include <memory>
+#include <string>
+#include <vector>
 
 
 class Application {
@@ -15,6 +22,34 @@ public:
     bool initialize();
     void run();
 
+    // Solver and settings of the pressure solve
+    void setPressureOptions(const PressureOptions& options) { pressureOptions = options; }
+    // Fused confinement/divergence pass instead of the separate passes
+    void setFusedPasses(bool fused) { fusedPasses = fused; }
+    // Fixed simulation rate in steps per second, independent of the frame
+    // rate; the display interpolates between steps
+    void setSimulationRate(double rate) { simulationRate = rate; }
+    // A positive Courant number replaces the fixed rate with the largest
+    // step that keeps the fastest texel within that many cells per step
+    void setCourantNumber(float courant) { courantNumber = courant; }
+    // Square dye field size, 0 to match the simulation grid
+    void setDyeResolution(int size) { dyeResolution = size; }
+    // Initial square simulation grid
+    void setGridSize(int size) { gridSize = size; }
+    void setFieldPrecision(FieldPrecision precision) { fieldPrecision = precision; }
+    // A positive budget lets a ResolutionController resize the grid to keep
+    // the GPU time per step near it
+    void setStepBudget(double milliseconds) { stepBudget = milliseconds; }
+    // Steps only the moving tiles of the grid (see SparseSettings)
+    void setSparseSettings(const SparseSettings& settings) { sparseSettings = settings; }
+    // Times every pass on the GPU and prints min/mean/p99 per pass with the
+    // FPS line; a non-empty path also appends them there as CSV
+    void setProfiling(bool enabled, const std::string& csvPath) { profiling = enabled; profileCsvPath = csvPath; }
+    // Frames longer than the budget count as misses in the frame-time
+    // report; a non-empty path also gets every frame's timings as CSV
+    void setFrameBudget(double milliseconds) { frameBudget = milliseconds; }
+    void setFrameCsv(const std::string& path) { frameCsvPath = path; }
+
 private:
     int windowWidth, windowHeight;
     const char* windowTitle;
@@ -22,13 +57,42 @@ private:
 
     std::unique_ptr<FluidSimulation> fluidSim;
     std::unique_ptr<InputHandler> inputHandler;
+    PressureOptions pressureOptions;
+    bool fusedPasses;
 
+    SimulationClock clock;
+    double simulationRate;
+    float courantNumber;
+    int dyeResolution;
+    int gridSize;
+    FieldPrecision fieldPrecision;
+    double stepBudget;
+    SparseSettings sparseSettings;
+    std::unique_ptr<ResolutionController> resolutionController;
+    bool profiling;
+    std::string profileCsvPath;
+    std::unique_ptr<GpuProfiler> profiler;
+    std::ofstream profileCsv;
+    double startTime;
+    bool traceKeyDown;
     double lastTime;
-    double fpsTime;
-    int frameCount;
+    FrameStats frameStats;
+    FrameSample frameSample;    // timings of the frame in progress
+    double frameBudget;
+    std::string frameCsvPath;
+    double reportTime;
+
+    // Cursor events drained each frame, and the end of the stroke so far
+    std::vector<CursorEvent> cursorEvents;
+    bool strokeActive;
+    CursorEvent strokeEnd;
+    float strokeCarry;      // texels walked since the last splat
 
-    void processInput(float dt);
-    void updateFPS();
+    void processInput(float dt, bool stepping);
+    void strokeSegment(const CursorEvent& from, const CursorEvent& to, float force);
+    void strokeSplat(float x, float y, float fx, float fy, double time);
+    void updateResolution();
+    void reportFrameStats();
 
     static void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 };
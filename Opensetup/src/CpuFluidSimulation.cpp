@@ -0,0 +1,280 @@
+#include "CpuFluidSimulation.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    inline int clampIndex(int i, int n) {
+        return i < 0 ? 0 : (i >= n ? n - 1 : i);
+    }
+
+    // Equivalent of texture() on a GL_LINEAR, GL_CLAMP_TO_EDGE texture
+    inline void sampleBilinear(const float* field, int w, int h, int channels, float u, float v, float* out) {
+        float x = u * w - 0.5f;
+        float y = v * h - 0.5f;
+        float fx0 = std::floor(x);
+        float fy0 = std::floor(y);
+        float tx = x - fx0;
+        float ty = y - fy0;
+        int x0 = clampIndex((int)fx0, w);
+        int x1 = clampIndex((int)fx0 + 1, w);
+        int y0 = clampIndex((int)fy0, h);
+        int y1 = clampIndex((int)fy0 + 1, h);
+
+        const float* a = field + (y0 * w + x0) * channels;
+        const float* b = field + (y0 * w + x1) * channels;
+        const float* c = field + (y1 * w + x0) * channels;
+        const float* d = field + (y1 * w + x1) * channels;
+        for (int k = 0; k < channels; k++) {
+            float bottom = a[k] + (b[k] - a[k]) * tx;
+            float top = c[k] + (d[k] - c[k]) * tx;
+            out[k] = bottom + (top - bottom) * ty;
+        }
+    }
+}
+
+CpuFluidSimulation::CpuFluidSimulation(int width, int height, int threadCount)
+    : gridW(width), gridH(height), currentVel(0), currentDye(0), currentPressure(0), pressureIterations(20),
+    pool(threadCount) {
+}
+
+void CpuFluidSimulation::init() {
+    size_t cells = (size_t)gridW * gridH;
+    for (int i = 0; i < 2; i++) {
+        velocity[i].assign(cells * 2, 0.0f);
+        dye[i].assign(cells * 3, 0.0f);
+        pressure[i].assign(cells, 0.0f);
+    }
+    divergence.assign(cells, 0.0f);
+    vorticity.assign(cells, 0.0f);
+
+    initVelocityField();
+}
+
+void CpuFluidSimulation::initVelocityField() {
+    for (int j = 0; j < gridH; j++) {
+        for (int i = 0; i < gridW; i++) {
+            float x = (i + 0.5f) / gridW * 2.0f - 1.0f;
+            float y = (j + 0.5f) / gridH * 2.0f - 1.0f;
+            float len = sqrt(x * x + y * y) + 0.001f;
+
+            int idx = (j * gridW + i) * 2;
+            velocity[0][idx + 0] = y / len * 0.1f;
+            velocity[0][idx + 1] = -x / len * 0.1f;
+        }
+    }
+    velocity[1] = velocity[0];
+}
+
+void CpuFluidSimulation::advect(const std::vector<float>& field, std::vector<float>& out, int channels, float dt) {
+    const float* vel = velocity[currentVel].data();
+    const float* src = field.data();
+    float* dst = out.data();
+    // Matches advect_fs with texelSize = (1, 1): the velocity is a uv offset per unit dt
+    float scaledDt = dt * advectionScale;
+
+    pool.parallelFor(0, gridH, [&](int rowBegin, int rowEnd) {
+        for (int j = rowBegin; j < rowEnd; j++) {
+            float v = (j + 0.5f) / gridH;
+            for (int i = 0; i < gridW; i++) {
+                float u = (i + 0.5f) / gridW;
+                const float* cellVel = vel + (j * gridW + i) * 2;
+                float prevU = u - scaledDt * cellVel[0];
+                float prevV = v - scaledDt * cellVel[1];
+                sampleBilinear(src, gridW, gridH, channels, prevU, prevV, dst + (j * gridW + i) * channels);
+            }
+        }
+    });
+}
+
+void CpuFluidSimulation::advectVelocity(float dt) {
+    advect(velocity[currentVel], velocity[1 - currentVel], 2, dt);
+    currentVel = 1 - currentVel;
+}
+
+void CpuFluidSimulation::advectDye(float dt) {
+    advect(dye[currentDye], dye[1 - currentDye], 3, dt);
+    currentDye = 1 - currentDye;
+}
+
+void CpuFluidSimulation::computeDivergence() {
+    const float* vel = velocity[currentVel].data();
+    float* div = divergence.data();
+
+    pool.parallelFor(0, gridH, [&](int rowBegin, int rowEnd) {
+        for (int j = rowBegin; j < rowEnd; j++) {
+            int jb = clampIndex(j - 1, gridH);
+            int jt = clampIndex(j + 1, gridH);
+            for (int i = 0; i < gridW; i++) {
+                int il = clampIndex(i - 1, gridW);
+                int ir = clampIndex(i + 1, gridW);
+                float left = vel[(j * gridW + il) * 2 + 0];
+                float right = vel[(j * gridW + ir) * 2 + 0];
+                float bottom = vel[(jb * gridW + i) * 2 + 1];
+                float top = vel[(jt * gridW + i) * 2 + 1];
+                div[j * gridW + i] = 0.5f * ((right - left) + (top - bottom));
+            }
+        }
+    });
+}
+
+void CpuFluidSimulation::solvePressure(int iterations) {
+    const float alpha = -1.0f;
+    const float beta = 0.25f;
+    const float* div = divergence.data();
+
+    std::fill(pressure[currentPressure].begin(), pressure[currentPressure].end(), 0.0f);
+
+    for (int it = 0; it < iterations; it++) {
+        const float* p = pressure[currentPressure].data();
+        float* out = pressure[1 - currentPressure].data();
+
+        pool.parallelFor(0, gridH, [&](int rowBegin, int rowEnd) {
+            for (int j = rowBegin; j < rowEnd; j++) {
+                const float* rowBottom = p + clampIndex(j - 1, gridH) * gridW;
+                const float* row = p + j * gridW;
+                const float* rowTop = p + clampIndex(j + 1, gridH) * gridW;
+                for (int i = 0; i < gridW; i++) {
+                    float left = row[clampIndex(i - 1, gridW)];
+                    float right = row[clampIndex(i + 1, gridW)];
+                    out[j * gridW + i] = (left + right + rowBottom[i] + rowTop[i] + alpha * div[j * gridW + i]) * beta;
+                }
+            }
+        });
+
+        currentPressure = 1 - currentPressure;
+    }
+}
+
+void CpuFluidSimulation::computeVorticity() {
+    const float* vel = velocity[currentVel].data();
+    float* curl = vorticity.data();
+
+    pool.parallelFor(0, gridH, [&](int rowBegin, int rowEnd) {
+        for (int j = rowBegin; j < rowEnd; j++) {
+            int jb = clampIndex(j - 1, gridH);
+            int jt = clampIndex(j + 1, gridH);
+            for (int i = 0; i < gridW; i++) {
+                int il = clampIndex(i - 1, gridW);
+                int ir = clampIndex(i + 1, gridW);
+                float leftY = vel[(j * gridW + il) * 2 + 1];
+                float rightY = vel[(j * gridW + ir) * 2 + 1];
+                float bottomX = vel[(jb * gridW + i) * 2 + 0];
+                float topX = vel[(jt * gridW + i) * 2 + 0];
+                curl[j * gridW + i] = 0.5f * ((rightY - leftY) - (topX - bottomX));
+            }
+        }
+    });
+}
+
+void CpuFluidSimulation::applyVorticityConfinement(float dt) {
+    const float strength = 0.3f;
+    const float* vel = velocity[currentVel].data();
+    const float* curl = vorticity.data();
+    float* out = velocity[1 - currentVel].data();
+
+    pool.parallelFor(0, gridH, [&](int rowBegin, int rowEnd) {
+        for (int j = rowBegin; j < rowEnd; j++) {
+            int jb = clampIndex(j - 1, gridH);
+            int jt = clampIndex(j + 1, gridH);
+            for (int i = 0; i < gridW; i++) {
+                int il = clampIndex(i - 1, gridW);
+                int ir = clampIndex(i + 1, gridW);
+                float left = curl[j * gridW + il];
+                float right = curl[j * gridW + ir];
+                float bottom = curl[jb * gridW + i];
+                float top = curl[jt * gridW + i];
+                float center = curl[j * gridW + i];
+
+                float gx = (std::fabs(right) - std::fabs(left)) * 0.5f;
+                float gy = (std::fabs(top) - std::fabs(bottom)) * 0.5f;
+                float len = std::sqrt(gx * gx + gy * gy) + 1e-5f;
+                gx /= len;
+                gy /= len;
+
+                int idx = (j * gridW + i) * 2;
+                out[idx + 0] = vel[idx + 0] + gy * center * strength * dt;
+                out[idx + 1] = vel[idx + 1] - gx * center * strength * dt;
+            }
+        }
+    });
+
+    currentVel = 1 - currentVel;
+}
+
+void CpuFluidSimulation::subtractGradient() {
+    const float* vel = velocity[currentVel].data();
+    const float* p = pressure[currentPressure].data();
+    float* out = velocity[1 - currentVel].data();
+
+    pool.parallelFor(0, gridH, [&](int rowBegin, int rowEnd) {
+        for (int j = rowBegin; j < rowEnd; j++) {
+            int jb = clampIndex(j - 1, gridH);
+            int jt = clampIndex(j + 1, gridH);
+            for (int i = 0; i < gridW; i++) {
+                float left = p[j * gridW + clampIndex(i - 1, gridW)];
+                float right = p[j * gridW + clampIndex(i + 1, gridW)];
+                float bottom = p[jb * gridW + i];
+                float top = p[jt * gridW + i];
+
+                int idx = (j * gridW + i) * 2;
+                out[idx + 0] = vel[idx + 0] - 0.5f * (right - left);
+                out[idx + 1] = vel[idx + 1] - 0.5f * (top - bottom);
+            }
+        }
+    });
+
+    currentVel = 1 - currentVel;
+}
+
+void CpuFluidSimulation::splat(const std::vector<float>& base, std::vector<float>& out, int channels,
+    float px, float py, const float* color, float radius, float strength) {
+    const float* src = base.data();
+    float* dst = out.data();
+
+    pool.parallelFor(0, gridH, [&](int rowBegin, int rowEnd) {
+        for (int j = rowBegin; j < rowEnd; j++) {
+            // Distances are measured between pixel centres, like gl_FragCoord
+            float dy = (j + 0.5f) - py;
+            for (int i = 0; i < gridW; i++) {
+                float dx = (i + 0.5f) - px;
+                float amount = std::exp(-(dx * dx + dy * dy) / radius) * strength;
+                int idx = (j * gridW + i) * channels;
+                for (int k = 0; k < channels; k++) {
+                    dst[idx + k] = src[idx + k] + color[k] * amount;
+                }
+            }
+        }
+    });
+}
+
+void CpuFluidSimulation::addForce(float x, float y, float fx, float fy) {
+    const float color[2] = { fx, fy };
+    splat(velocity[currentVel], velocity[1 - currentVel], 2, x * gridW, y * gridH, color, 200.0f, 0.05f);
+    currentVel = 1 - currentVel;
+}
+
+void CpuFluidSimulation::addDye(float x, float y, float r, float g, float b) {
+    const float color[3] = { r, g, b };
+    splat(dye[currentDye], dye[1 - currentDye], 3, x * gridW, y * gridH, color, 100.0f, 0.8f);
+    currentDye = 1 - currentDye;
+}
+
+void CpuFluidSimulation::step(float dt) {
+    TRACE_ZONE("step");
+    advectVelocity(dt);
+    computeVorticity();
+    applyVorticityConfinement(dt);
+    computeDivergence();
+    solvePressure(pressureIterations);
+    subtractGradient();
+    advectDye(dt);
+}
+
+void CpuFluidSimulation::readVelocity(std::vector<float>& out) {
+    out = velocity[currentVel];
+}
+
+void CpuFluidSimulation::readDye(std::vector<float>& out) {
+    out = dye[currentDye];
+}
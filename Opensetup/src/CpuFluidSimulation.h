@@ -0,0 +1,59 @@
+#ifndef CPU_FLUID_SIMULATION_H
+#define CPU_FLUID_SIMULATION_H
+
+#include "FluidSolver.h"
+#include "ThreadPool.h"
+#include <vector>
+
+// Native CPU implementation of the FluidSimulation step pipeline. Every pass
+// mirrors the corresponding shader in ShaderSources.h (texel-centre sampling,
+// clamp-to-edge, bilinear filtering) and is parallelised over grid rows.
+class CpuFluidSimulation : public FluidSolver {
+public:
+    CpuFluidSimulation(int width, int height, int threadCount = 0);
+
+    void init() override;
+    void step(float dt) override;
+    void addForce(float x, float y, float fx, float fy) override;
+    void addDye(float x, float y, float r, float g, float b) override;
+
+    void readVelocity(std::vector<float>& out) override;
+    void readDye(std::vector<float>& out) override;
+
+    int getThreadCount() const { return pool.size(); }
+    // Jacobi sweeps per step
+    void setPressureIterations(int iterations) { pressureIterations = iterations; }
+    int getPressureIterations() const { return pressureIterations; }
+
+private:
+    int gridW, gridH;
+
+    // Fields, interleaved per texel like the GL textures (RG, RGB, R)
+    std::vector<float> velocity[2];
+    std::vector<float> dye[2];
+    std::vector<float> pressure[2];
+    std::vector<float> divergence;
+    std::vector<float> vorticity;
+
+    int currentVel;
+    int currentDye;
+    int currentPressure;
+    int pressureIterations;
+
+    ThreadPool pool;
+
+    void initVelocityField();
+
+    void advect(const std::vector<float>& field, std::vector<float>& out, int channels, float dt);
+    void advectVelocity(float dt);
+    void advectDye(float dt);
+    void computeDivergence();
+    void solvePressure(int iterations);
+    void computeVorticity();
+    void applyVorticityConfinement(float dt);
+    void subtractGradient();
+    void splat(const std::vector<float>& base, std::vector<float>& out, int channels,
+        float px, float py, const float* color, float radius, float strength);
+};
+
+#endif
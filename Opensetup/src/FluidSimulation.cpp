@@ -1,39 +1,199 @@
 #include "FluidSimulation.h"
 #include "ShaderSources.h"
+#include "GLExtensions.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
 #include <vector>
 
+// std140 layouts of the uniform blocks in ShaderSources.h
+struct FrameConstants {
+    float texelSize[2];
+    float dt;
+    float advectionDt;
+    float confinementStrength;
+    float padding[3];
+};
+
+struct LevelConstants {
+    float texelSize[2];
+    float h2;           // squared grid spacing in finest-level texels
+    float padding;
+};
+
+struct SplatConstants {
+    float pointRadius[4];   // point in texels, radius, strength
+    float color[4];
+};
+
+static const GLuint frameConstantsBinding = 0;
+static const GLuint levelConstantsBinding = 1;
+static const GLuint splatsBinding = 2;
+static const int maxSplatsPerPass = 256;    // MAX_SPLATS in splat_fs
+
 FluidSimulation::FluidSimulation(int width, int height)
-    : gridW(width), gridH(height), currentVel(0), currentDye(0), currentPressure(0) {
+    : gridW(width), gridH(height), dyeW(width), dyeH(height),
+    fieldPrecision(FieldPrecision::Full), frameConstantsBuffer(0), levelConstantsBuffer(0), splatBuffer(0),
+    fusedPasses(false), previousDyeValid(false),
+    pressureSolver(PressureSolver::Jacobi), pressureIterations(20),
+    pressurePath(PressurePath::Auto), useComputePressure(false), chebyshevIteration(0), chebyshevOmega(1.0f),
+    pressureWarmStart(PressureWarmStart::Zero), pressureHistoryCount(0), frameIndex(0), convergedFrames(0),
+    pressureIterationBudget(20), lastPressureIterations(0), lastPressureResidual(-1.0f),
+    profiler(nullptr), velocityMonitoring(false), maxVelocity(-1.0f) {
 }
 
 FluidSimulation::~FluidSimulation() {
-    glDeleteTextures(2, velocityTextures);
-    glDeleteTextures(2, dyeTextures);
-    glDeleteTextures(2, pressureTextures);
-    glDeleteTextures(1, &divergenceTexture);
-    glDeleteTextures(1, &vorticityTexture);
-    glDeleteFramebuffers(2, framebuffers);
+    velocity.destroy();
+    dye.destroy();
+    pressure.destroy();
+    destroyScratchTargets();
     glDeleteVertexArrays(1, &quadVAO);
+    deleteMultigridLevels();
+    glDeleteBuffers(1, &frameConstantsBuffer);
+    glDeleteBuffers(1, &levelConstantsBuffer);
+    glDeleteBuffers(1, &splatBuffer);
 }
 
 void FluidSimulation::init() {
+    TRACE_ZONE("init simulation");
+    // Programs build in the background while the targets are allocated and
+    // the velocity field is filled in
+    chooseFieldFormats();
     createShaders();
 
-    glGenFramebuffers(2, framebuffers);
-
-    createTexturePair(velocityTextures, GL_RG32F, GL_RG, GL_FLOAT);
-    createTexturePair(dyeTextures, GL_RGB32F, GL_RGB, GL_FLOAT);
-    createTexturePair(pressureTextures, GL_R32F, GL_RED, GL_FLOAT);
+    velocity.create(gridW, gridH, velocityFormat.internalFormat, velocityFormat.format, GL_FLOAT);
+    dye.create(dyeW, dyeH, dyeFormat.internalFormat, dyeFormat.format, GL_FLOAT);
+    pressure.create(gridW, gridH, pressureFormat.internalFormat, pressureFormat.format, GL_FLOAT);
+    createScratchTargets();
+    if (!tileVariants.empty()) {
+        tileActivity = std::make_unique<TileActivity>();
+        tileActivity->init(gridW, gridH);
+    }
 
-    glGenTextures(1, &divergenceTexture);
-    setupTexture(divergenceTexture, GL_R32F, GL_RED, GL_FLOAT);
+    residualReduction = std::make_unique<GpuReduction>();
+    residualReduction->init(gridW, gridH);
 
-    glGenTextures(1, &vorticityTexture);
-    setupTexture(vorticityTexture, GL_R32F, GL_RED, GL_FLOAT);
+    // Frame constants stay bound for the life of the simulation; solver
+    // passes bind the constants of the level they work on
+    glGenBuffers(1, &frameConstantsBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameConstantsBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameConstants), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, frameConstantsBinding, frameConstantsBuffer);
+    updateFrameConstants(0.0f);
+    levelConstantsBuffer = createLevelConstants(gridW, gridH, 1.0f);
+    glGenBuffers(1, &splatBuffer);
 
     quadVAO = createQuadVAO();
     initVelocityField();
+    finishShaders();
+    choosePressurePath();
+}
+
+void FluidSimulation::chooseFieldFormats() {
+    // RGB32F is not required to be colour-renderable, so the dye has alpha
+    switch (fieldPrecision) {
+    case FieldPrecision::Full:
+        velocityFormat = { GL_RG32F, GL_RG, 8 };
+        pressureFormat = { GL_R32F, GL_RED, 4 };
+        dyeFormat = { GL_RGBA32F, GL_RGBA, 16 };
+        break;
+    case FieldPrecision::Half:
+        velocityFormat = { GL_RG16F, GL_RG, 4 };
+        pressureFormat = { GL_R16F, GL_RED, 2 };
+        dyeFormat = { GL_RGBA16F, GL_RGBA, 8 };
+        break;
+    case FieldPrecision::Packed:
+        velocityFormat = { GL_RG16F, GL_RG, 4 };
+        pressureFormat = { GL_R16F, GL_RED, 2 };
+        dyeFormat = { GL_R11F_G11F_B10F, GL_RGB, 4 };
+        break;
+    }
+}
+
+size_t FluidSimulation::getFieldMemory() const {
+    size_t texels = (size_t)gridW * gridH;
+    size_t bytes = texels * velocityFormat.bytesPerTexel * 2;
+    // pressure pair, history and the Chebyshev previous iterate
+    bytes += texels * pressureFormat.bytesPerTexel * 4;
+    // divergence, vorticity and residual
+    bytes += texels * 4 * 3;
+    bytes += (size_t)dyeW * dyeH * dyeFormat.bytesPerTexel * 2;
+    return bytes;
+}
+
+void FluidSimulation::createScratchTargets() {
+    pressureHistory.create(gridW, gridH, pressureFormat.internalFormat, pressureFormat.format, GL_FLOAT);
+    chebyshevPrevious.create(gridW, gridH, pressureFormat.internalFormat, pressureFormat.format, GL_FLOAT);
+    divergence.create(gridW, gridH, GL_R32F, GL_RED, GL_FLOAT);
+    vorticity.create(gridW, gridH, GL_R32F, GL_RED, GL_FLOAT);
+    residual.create(gridW, gridH, GL_R32F, GL_RED, GL_FLOAT);
+}
+
+void FluidSimulation::destroyScratchTargets() {
+    pressureHistory.destroy();
+    chebyshevPrevious.destroy();
+    divergence.destroy();
+    vorticity.destroy();
+    residual.destroy();
+    for (RenderTargetPair& pair : targetPairs) {
+        pair.destroy();
+    }
+    targetPairs.clear();
+}
+
+void FluidSimulation::resample(DoubleRenderTarget& field, int width, int height, const FieldFormat& format) {
+    DoubleRenderTarget resized;
+    resized.create(width, height, format.internalFormat, format.format, GL_FLOAT);
+    const RenderTarget& source = field.read();
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source.framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resized.read().framebuffer);
+    glBlitFramebuffer(0, 0, source.width, source.height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    field.destroy();
+    field = resized;
+}
+
+void FluidSimulation::resize(int width, int height) {
+    if (width == gridW && height == gridH) return;
+
+    // Queued splats are in normalised coordinates and land after the resize
+    int newDyeW = std::max(1, (int)((long long)dyeW * width / gridW));
+    int newDyeH = std::max(1, (int)((long long)dyeH * height / gridH));
+    resample(velocity, width, height, velocityFormat);
+    resample(pressure, width, height, pressureFormat);
+    resample(dye, newDyeW, newDyeH, dyeFormat);
+    gridW = width;
+    gridH = height;
+    dyeW = newDyeW;
+    dyeH = newDyeH;
+
+    destroyScratchTargets();
+    createScratchTargets();
+    deleteMultigridLevels();
+    glDeleteBuffers(1, &levelConstantsBuffer);
+    levelConstantsBuffer = createLevelConstants(gridW, gridH, 1.0f);
+
+    residualReduction->init(gridW, gridH);
+    if (measureReduction) measureReduction->init(gridW, gridH);
+    if (velocityReduction) velocityReduction->init(gridW, gridH);
+    if (tileActivity) {
+        // Only the read buffers were resampled; restarting with every tile
+        // active rewrites or copies all of the write buffers on the next step
+        tileActivity->init(gridW, gridH);
+        for (const auto& variant : tileVariants) {
+            tileActivity->configure(*variant.second);
+        }
+        glUseProgram(0);
+    }
+
+    // The resampled pressure can still seed the next solve, but the older
+    // history and the previous dye frame are gone
+    pressureHistoryCount = std::min(pressureHistoryCount, 1);
+    previousDyeValid = false;
 }
 
 void FluidSimulation::createShaders() {
@@ -41,26 +201,135 @@ void FluidSimulation::createShaders() {
     divergenceShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::divergence_fs);
     pressureShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::pressure_fs);
     gradientShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::gradient_fs);
-    splatShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::splat_fs);
+    splatShader = std::make_unique<Shader>(ShaderSources::splat_vs, ShaderSources::splat_fs);
     displayShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::display_fs);
     vorticityShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::vorticity_fs);
     confinementShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::confinement_fs);
+    smoothShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::smooth_fs);
+    residualShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::residual_fs);
+    restrictShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::restrict_fs);
+    prolongateShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::prolongate_fs);
+    extrapolateShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::extrapolate_fs);
+    removeMeanShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::remove_mean_fs);
+    confinementDivergenceShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::confinement_divergence_fs);
+    sorShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::sor_fs);
+    chebyshevShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::chebyshev_fs);
+    if (GLExtensions::hasComputeShaders()) {
+        // The image format has to match the pressure storage
+        std::string source = ShaderSources::jacobi_tiled_cs;
+        if (pressureFormat.internalFormat == GL_R16F) {
+            source.replace(source.find("r32f"), 4, "r16f");
+        }
+        jacobiTiledShader = std::make_unique<Shader>(source.c_str());
+    }
+    if (sparseSettings.enabled) {
+        if (GLExtensions::hasComputeShaders() && GLExtensions::hasIndirectDraws()) {
+            // The pressure passes stay full-domain, so only the transport
+            // and force passes get a tile build
+            std::pair<const Shader*, const char*> passes[] = {
+                { advectShader.get(), ShaderSources::advect_fs },
+                { divergenceShader.get(), ShaderSources::divergence_fs },
+                { gradientShader.get(), ShaderSources::gradient_fs },
+                { vorticityShader.get(), ShaderSources::vorticity_fs },
+                { confinementShader.get(), ShaderSources::confinement_fs },
+                { confinementDivergenceShader.get(), ShaderSources::confinement_divergence_fs } };
+            for (const auto& pass : passes) {
+                tileVariants[pass.first] = std::make_unique<Shader>(ShaderSources::tile_vs, pass.second);
+            }
+        }
+        else {
+            std::cout << "Sparse stepping needs GL 4.3, stepping the whole grid" << std::endl;
+        }
+    }
 }
 
-void FluidSimulation::createTexturePair(GLuint textures[2], GLenum internalFormat, GLenum format, GLenum type) {
-    for (int i = 0; i < 2; i++) {
-        glGenTextures(1, &textures[i]);
-        setupTexture(textures[i], internalFormat, format, type);
+void FluidSimulation::finishShaders() {
+    Shader* shaders[] = { advectShader.get(), divergenceShader.get(), pressureShader.get(), gradientShader.get(),
+        splatShader.get(), displayShader.get(), vorticityShader.get(), confinementShader.get(), smoothShader.get(),
+        residualShader.get(), restrictShader.get(), prolongateShader.get(), extrapolateShader.get(),
+        removeMeanShader.get(), confinementDivergenceShader.get(), sorShader.get(), chebyshevShader.get(),
+        jacobiTiledShader.get() };
+    for (Shader* shader : shaders) {
+        if (shader) shader->finish();
+    }
+    for (const auto& variant : tileVariants) {
+        variant.second->finish();
+    }
+
+    if (jacobiTiledShader) {
+        jacobiTiledShader->bindSamplers({ "pressure", "divergence" });
+    }
+    // Texture units never change, so samplers are assigned once here. Tile
+    // variants take the same units as their full-grid program.
+    auto bindPassSamplers = [this](const Shader* shader, std::initializer_list<const char*> names) {
+        shader->bindSamplers(names);
+        auto variant = tileVariants.find(shader);
+        if (variant != tileVariants.end()) variant->second->bindSamplers(names);
+    };
+    bindPassSamplers(advectShader.get(), { "field", "velocity" });
+    bindPassSamplers(divergenceShader.get(), { "velocity" });
+    pressureShader->bindSamplers({ "pressure", "divergence" });
+    bindPassSamplers(gradientShader.get(), { "velocity", "pressure" });
+    displayShader->bindSamplers({ "tex", "previous" });
+    bindPassSamplers(vorticityShader.get(), { "velocity" });
+    bindPassSamplers(confinementShader.get(), { "velocity", "vorticity" });
+    smoothShader->bindSamplers({ "pressure", "divergence" });
+    residualShader->bindSamplers({ "pressure", "divergence" });
+    restrictShader->bindSamplers({ "fine" });
+    prolongateShader->bindSamplers({ "pressure", "correction" });
+    extrapolateShader->bindSamplers({ "pressure", "previousPressure" });
+    removeMeanShader->bindSamplers({ "field", "sums" });
+    bindPassSamplers(confinementDivergenceShader.get(), { "velocity", "vorticity" });
+    sorShader->bindSamplers({ "pressure", "divergence" });
+    chebyshevShader->bindSamplers({ "pressure", "previousPressure", "divergence" });
+    glUseProgram(0);
+
+    const Shader* frameShaders[] = { advectShader.get(), divergenceShader.get(), gradientShader.get(),
+        vorticityShader.get(), confinementShader.get(), confinementDivergenceShader.get(), splatShader.get() };
+    for (const Shader* shader : frameShaders) {
+        shader->bindUniformBlock("FrameConstants", frameConstantsBinding);
+    }
+    for (const auto& variant : tileVariants) {
+        variant.second->bindUniformBlock("FrameConstants", frameConstantsBinding);
+        tileActivity->configure(*variant.second);
+    }
+    const Shader* levelShaders[] = { pressureShader.get(), smoothShader.get(), residualShader.get(),
+        sorShader.get(), chebyshevShader.get() };
+    for (const Shader* shader : levelShaders) {
+        shader->bindUniformBlock("LevelConstants", levelConstantsBinding);
     }
+    splatShader->bindUniformBlock("Splats", splatsBinding);
+}
+
+void FluidSimulation::updateFrameConstants(float dt) {
+    FrameConstants constants;
+    constants.texelSize[0] = 1.0f / gridW;
+    constants.texelSize[1] = 1.0f / gridH;
+    constants.dt = dt;
+    constants.advectionDt = dt * advectionScale;
+    constants.confinementStrength = 0.3f;
+    glBindBuffer(GL_UNIFORM_BUFFER, frameConstantsBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(constants), &constants);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+GLuint FluidSimulation::createLevelConstants(int width, int height, float h2) {
+    LevelConstants constants;
+    constants.texelSize[0] = 1.0f / width;
+    constants.texelSize[1] = 1.0f / height;
+    constants.h2 = h2;
+    constants.padding = 0.0f;
+
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(constants), &constants, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    return buffer;
 }
 
-void FluidSimulation::setupTexture(GLuint texture, GLenum internalFormat, GLenum format, GLenum type) {
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, gridW, gridH, 0, format, type, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+void FluidSimulation::bindLevelConstants(GLuint buffer) {
+    glBindBufferBase(GL_UNIFORM_BUFFER, levelConstantsBinding, buffer);
 }
 
 GLuint FluidSimulation::createQuadVAO() {
@@ -102,233 +371,967 @@ void FluidSimulation::initVelocityField() {
         }
     }
 
-    glBindTexture(GL_TEXTURE_2D, velocityTextures[0]);
+    glBindTexture(GL_TEXTURE_2D, velocity.targets[0].texture);
     glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gridW, gridH, GL_RG, GL_FLOAT, velData.data());
-    glBindTexture(GL_TEXTURE_2D, velocityTextures[1]);
+    glBindTexture(GL_TEXTURE_2D, velocity.targets[1].texture);
     glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gridW, gridH, GL_RG, GL_FLOAT, velData.data());
 }
 
-void FluidSimulation::bindFramebuffer(GLuint texture) {
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[0]);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
-    glViewport(0, 0, gridW, gridH);
+const RenderTargetPair& FluidSimulation::getTargetPair(const RenderTarget& first, const RenderTarget& second) {
+    // Ping-pong swaps only ever produce a handful of combinations, so each
+    // gets its own framebuffer the first time it is drawn into
+    for (const RenderTargetPair& pair : targetPairs) {
+        if (pair.textures[0] == first.texture && pair.textures[1] == second.texture) {
+            return pair;
+        }
+    }
+    RenderTargetPair pair;
+    pair.create(first, second);
+    targetPairs.push_back(pair);
+    return targetPairs.back();
 }
 
 void FluidSimulation::unbindFramebuffer() {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void FluidSimulation::advectVelocity(float dt) {
-    bindFramebuffer(velocityTextures[1 - currentVel]);
+void FluidSimulation::drawField(const Shader& shader) {
+    if (tileActivity) {
+        tileVariants.at(&shader)->use();
+        tileActivity->drawActive();
+        return;
+    }
+    shader.use();
+    glBindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+}
 
-    advectShader->use();
-    advectShader->setFloat("dt", dt * 50.0f);
-    advectShader->setVec2("texelSize", 1.0f, 1.0f);
+void FluidSimulation::updateActiveTiles() {
+    GpuProfiler::Scope scope(profiler, "tiles");
+    tileActivity->update(velocity.read().texture, sparseSettings.velocityThreshold, sparseSettings.dilation);
+    // Tiles that stopped need their second buffer caught up before the
+    // passes leave them alone
+    tileActivity->copyRetired(velocity);
+    tileActivity->copyRetired(dye);
+
+    // The solve reads the divergence everywhere, and confinement reads the
+    // vorticity around the active tiles, so both are zero where nothing is
+    // drawn. Clearing the whole target also covers the divergence trading
+    // places with the residual.
+    divergence.bind();
+    glClear(GL_COLOR_BUFFER_BIT);
+    vorticity.bind();
+    glClear(GL_COLOR_BUFFER_BIT);
+    unbindFramebuffer();
+}
+
+int FluidSimulation::getTileCount() const {
+    if (tileActivity) return tileActivity->getTileCount();
+    int size = TileActivity::tileSize;
+    return ((gridW + size - 1) / size) * ((gridH + size - 1) / size);
+}
+
+int FluidSimulation::readActiveTiles() const {
+    return tileActivity ? tileActivity->readActiveCount() : getTileCount();
+}
+
+void FluidSimulation::advectVelocity() {
+    GpuProfiler::Scope scope(profiler, "advect");
+    velocity.write().bind();
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, velocityTextures[currentVel]);
-    advectShader->setInt("field", 0);
+    glBindTexture(GL_TEXTURE_2D, velocity.read().texture);
 
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, velocityTextures[currentVel]);
-    advectShader->setInt("velocity", 1);
+    glBindTexture(GL_TEXTURE_2D, velocity.read().texture);
 
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    drawField(*advectShader);
 
-    currentVel = 1 - currentVel;
+    velocity.swap();
     unbindFramebuffer();
 }
 
 void FluidSimulation::computeDivergence() {
-    bindFramebuffer(divergenceTexture);
-
-    divergenceShader->use();
-    divergenceShader->setVec2("texelSize", 1.0f / gridW, 1.0f / gridH);
+    GpuProfiler::Scope scope(profiler, "divergence");
+    divergence.bind();
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, velocityTextures[currentVel]);
-    divergenceShader->setInt("velocity", 0);
+    glBindTexture(GL_TEXTURE_2D, velocity.read().texture);
 
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    drawField(*divergenceShader);
 
     unbindFramebuffer();
 }
 
 void FluidSimulation::solvePressure(int iterations) {
-    float alpha = -1.0f;
-    float beta = 0.25f;
+    // Red-black ordering turns the drift from a non-zero mean into a
+    // red/black offset that never converges, so SOR always needs it removed
+    if (pressureWarmStart != PressureWarmStart::Zero || pressureSolver == PressureSolver::RedBlackSOR) {
+        removeDivergenceMean();
+    }
+    if (adaptivePressure.enabled) {
+        // Results from earlier frames adjust the budget and tell the warm
+        // start which of the last solves converged
+        frameIndex++;
+        convergedFrames <<= 1;
+        pollResidualChecks();
+    }
+    warmStartPressure();
+    chebyshevIteration = 0;
+
+    if (!adaptivePressure.enabled) {
+        runPressureIterations(iterations);
+        lastPressureIterations = iterations;
+        pressureStats.steps++;
+        pressureStats.iterations += iterations;
+        return;
+    }
 
-    bindFramebuffer(pressureTextures[currentPressure]);
-    glClear(GL_COLOR_BUFFER_BIT);
+    int interval = pressureSolver == PressureSolver::Multigrid ? 1 : std::max(adaptivePressure.checkInterval, 1);
+    int budget = pressureIterationBudget;
+    int done = 0;
+    bool converged = false;
+    while (done < budget && !converged) {
+        int count = std::min(interval, budget - done);
+        runPressureIterations(count);
+        done += count;
+        requestResidualCheck(done, done >= budget);
+        converged = pollResidualChecks();
+    }
+    lastPressureIterations = done;
+    pressureStats.steps++;
+    pressureStats.iterations += done;
+}
+
+void FluidSimulation::removeDivergenceMean() {
+    // With clamp-to-edge (pure Neumann) boundaries the pressure equation only
+    // has a solution for a zero-mean divergence. Any mean left in it makes
+    // the iterations drift the pressure by a constant, which a warm start
+    // would carry over and amplify from step to step.
+    GpuProfiler::Scope scope(profiler, "divergence mean");
+    subtractMean(divergence.texture, residual);
+
+    // The residual texture is free until the solve needs it, so the two
+    // simply trade places
+    std::swap(divergence, residual);
+}
+
+void FluidSimulation::subtractMean(GLuint field, const RenderTarget& target) {
+    residualReduction->reduce(field, GpuReduction::Mode::Scalar);
+
+    target.bind();
+    removeMeanShader->use();
+    removeMeanShader->setFloat("invCount", 1.0f / (gridW * gridH));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, field);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, residualReduction->getResultTexture());
+    glBindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
     unbindFramebuffer();
+}
 
-    for (int i = 0; i < iterations; i++) {
-        bindFramebuffer(pressureTextures[1 - currentPressure]);
+void FluidSimulation::warmStartPressure() {
+    GpuProfiler::Scope scope(profiler, "warm start");
+    PressureWarmStart mode = pressureWarmStart;
+    // Fall back until enough earlier solves exist to seed from. The trend
+    // between two unconverged solves is mostly their leftover error, which
+    // extrapolation would amplify, so both must have met the tolerance.
+    bool convergedPair = adaptivePressure.enabled && (convergedFrames & 6u) == 6u;
+    if (mode == PressureWarmStart::Extrapolate && (pressureHistoryCount < 2 || !convergedPair)) {
+        mode = PressureWarmStart::Previous;
+    }
+    if (mode == PressureWarmStart::Previous && pressureHistoryCount < 1) {
+        mode = PressureWarmStart::Zero;
+    }
 
-        pressureShader->use();
-        pressureShader->setVec2("texelSize", 1.0f / gridW, 1.0f / gridH);
-        pressureShader->setFloat("alpha", alpha);
-        pressureShader->setFloat("beta", beta);
+    if (mode == PressureWarmStart::Zero) {
+        pressure.read().bind();
+        glClear(GL_COLOR_BUFFER_BIT);
+        unbindFramebuffer();
+    }
+    else if (mode == PressureWarmStart::Extrapolate) {
+        pressure.write().bind();
 
+        extrapolateShader->use();
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, pressureTextures[currentPressure]);
-        pressureShader->setInt("pressure", 0);
-
+        glBindTexture(GL_TEXTURE_2D, pressure.read().texture);
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, divergenceTexture);
-        pressureShader->setInt("divergence", 1);
+        glBindTexture(GL_TEXTURE_2D, pressureHistory.texture);
 
         glBindVertexArray(quadVAO);
         glDrawArrays(GL_TRIANGLES, 0, 6);
+        unbindFramebuffer();
 
-        currentPressure = 1 - currentPressure;
+        // p(n-1) becomes the history; the old history texture is reused as
+        // the spare ping-pong buffer
+        std::swap(pressureHistory, pressure.targets[pressure.current]);
+        pressure.swap();
+
+        // The pressure is only defined up to a constant, and the solves
+        // leave it drifting; extrapolating that drift only costs precision
+        subtractMean(pressure.read().texture, pressure.write());
+        pressure.swap();
+    }
+
+    if (pressureWarmStart == PressureWarmStart::Extrapolate && mode != PressureWarmStart::Extrapolate) {
+        // Record p(n-1) so the next solve can extrapolate
+        pressureHistory.bind();
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, pressure.read().framebuffer);
+        glBlitFramebuffer(0, 0, gridW, gridH, 0, 0, gridW, gridH, GL_COLOR_BUFFER_BIT, GL_NEAREST);
         unbindFramebuffer();
     }
+
+    pressureHistoryCount = std::min(pressureHistoryCount + 1, 2);
 }
 
-void FluidSimulation::computeVorticity() {
-    bindFramebuffer(vorticityTexture);
+void FluidSimulation::runPressureIterations(int count) {
+    GpuProfiler::Scope scope(profiler, "pressure");
+    switch (pressureSolver) {
+    case PressureSolver::RedBlackSOR:
+        sorIterations(count);
+        break;
+    case PressureSolver::ChebyshevJacobi:
+        chebyshevIterations(count);
+        break;
+    case PressureSolver::Multigrid:
+        multigridCycles(count);
+        break;
+    default:
+        jacobiIterations(count);
+        break;
+    }
+}
 
-    vorticityShader->use();
-    vorticityShader->setVec2("texelSize", 1.0f / gridW, 1.0f / gridH);
+void FluidSimulation::jacobiIterations(int iterations) {
+    if (useComputePressure) {
+        jacobiIterationsTiled(iterations);
+        return;
+    }
 
+    pressureShader->use();
+    bindLevelConstants(levelConstantsBuffer);
+    glBindVertexArray(quadVAO);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, divergence.texture);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, velocityTextures[currentVel]);
-    vorticityShader->setInt("velocity", 0);
 
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    for (int i = 0; i < iterations; i++) {
+        pressure.write().bind();
+        glBindTexture(GL_TEXTURE_2D, pressure.read().texture);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
 
+        pressure.swap();
+        unbindFramebuffer();
+    }
+}
+
+void FluidSimulation::choosePressurePath() {
+    useComputePressure = false;
+    if (!jacobiTiledShader || pressurePath == PressurePath::Fragment) return;
+    if (pressurePath == PressurePath::Compute) {
+        useComputePressure = true;
+        return;
+    }
+
+    // Fewer passes do not mean faster everywhere: software rasterisers run
+    // compute far slower than fragments. Time one four-sweep solve each way
+    // (after a warm-up run) on cleared fields.
+    const RenderTarget* cleared[3] = { &pressure.targets[0], &pressure.targets[1], &divergence };
+    for (const RenderTarget* target : cleared) {
+        target->bind();
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
     unbindFramebuffer();
+
+    // Timed around glFinish like measurePressureConvergence(); llvmpipe's
+    // timer queries report next to nothing for compute work
+    double elapsed[2] = { 0.0, 0.0 };
+    for (int path = 0; path < 2; path++) {
+        useComputePressure = path == 1;
+        jacobiIterations(4);
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        jacobiIterations(4);
+        glFinish();
+        elapsed[path] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    useComputePressure = elapsed[1] < elapsed[0];
 }
 
-void FluidSimulation::applyVorticityConfinement(float dt) {
-    bindFramebuffer(velocityTextures[1 - currentVel]);
+void FluidSimulation::jacobiIterationsTiled(int iterations) {
+    // Must match TILE and MAX_ITERATIONS in jacobi_tiled_cs
+    const int tile = 16;
+    const int maxIterations = 4;
 
-    confinementShader->use();
-    confinementShader->setVec2("texelSize", 1.0f / gridW, 1.0f / gridH);
-    confinementShader->setFloat("dt", dt);
-    confinementShader->setFloat("strength", 0.3f);
+    jacobiTiledShader->use();
+    jacobiTiledShader->setIVec2("gridSize", gridW, gridH);
+    jacobiTiledShader->setFloat("alpha", -1.0f);
+    jacobiTiledShader->setFloat("beta", 0.25f);
+    GLint iterationsLocation = jacobiTiledShader->getUniformLocation("iterations");
 
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, divergence.texture);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, velocityTextures[currentVel]);
-    confinementShader->setInt("velocity", 0);
 
+    // Each dispatch reads the pressure and divergence once and writes the
+    // pressure once for up to four sweeps, where the fragment path moves
+    // both for every sweep
+    for (int done = 0; done < iterations; done += maxIterations) {
+        jacobiTiledShader->setInt(iterationsLocation, std::min(maxIterations, iterations - done));
+        glBindTexture(GL_TEXTURE_2D, pressure.read().texture);
+        glBindImageTexture(0, pressure.write().texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, pressureFormat.internalFormat);
+        glDispatchCompute((gridW + tile - 1) / tile, (gridH + tile - 1) / tile, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        pressure.swap();
+    }
+
+    // Later passes render into, blit from and read back the pressure too
+    glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, pressureFormat.internalFormat);
+}
+
+float FluidSimulation::spectralRadius() const {
+    if (relaxationSettings.spectralRadius > 0.0f) {
+        return relaxationSettings.spectralRadius;
+    }
+    // Largest Jacobi eigenvalue below the constant mode for the Neumann
+    // Laplacian on this grid: the smoothest mode of the longer axis,
+    // constant along the other
+    const float pi = 3.14159265f;
+    return 0.5f * (1.0f + std::cos(pi / std::max(gridW, gridH)));
+}
+
+void FluidSimulation::sorIterations(int iterations) {
+    float omega = relaxationSettings.sorOmega;
+    if (omega <= 0.0f) {
+        float rho = spectralRadius();
+        omega = 2.0f / (1.0f + std::sqrt(1.0f - rho * rho));
+    }
+
+    sorShader->use();
+    sorShader->setFloat("omega", omega);
+    GLint parityLocation = sorShader->getUniformLocation("parity");
+    bindLevelConstants(levelConstantsBuffer);
+    glBindVertexArray(quadVAO);
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, vorticityTexture);
-    confinementShader->setInt("vorticity", 1);
+    glBindTexture(GL_TEXTURE_2D, divergence.texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    // GL 3.3 cannot sample the texture being rendered to, so each half-sweep
+    // writes the whole grid to the other buffer and copies the texels of the
+    // other colour through unchanged
+    for (int i = 0; i < iterations * 2; i++) {
+        pressure.write().bind();
+        sorShader->setInt(parityLocation, i & 1);
+        glBindTexture(GL_TEXTURE_2D, pressure.read().texture);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+
+        pressure.swap();
+        unbindFramebuffer();
+    }
+}
+
+void FluidSimulation::chebyshevIterations(int iterations) {
+    float rho = spectralRadius();
 
+    chebyshevShader->use();
+    GLint omegaLocation = chebyshevShader->getUniformLocation("omega");
+    bindLevelConstants(levelConstantsBuffer);
+    glBindVertexArray(quadVAO);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, divergence.texture);
+
+    for (int i = 0; i < iterations; i++) {
+        // omega(1) = 1, omega(2) = 2 / (2 - rho^2),
+        // omega(k+1) = 4 / (4 - rho^2 * omega(k))
+        if (chebyshevIteration == 0) {
+            chebyshevOmega = 1.0f;
+        }
+        else if (chebyshevIteration == 1) {
+            chebyshevOmega = 2.0f / (2.0f - rho * rho);
+        }
+        else {
+            chebyshevOmega = 4.0f / (4.0f - rho * rho * chebyshevOmega);
+        }
+
+        pressure.write().bind();
+        chebyshevShader->setFloat(omegaLocation, chebyshevOmega);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, pressure.read().texture);
+        // The first step is plain Jacobi, so p(k-1) is never read there
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, chebyshevIteration == 0 ? pressure.read().texture : chebyshevPrevious.texture);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        unbindFramebuffer();
+
+        // p(k) becomes p(k-1); the texture that held p(k-1) is the next
+        // free buffer
+        std::swap(chebyshevPrevious, pressure.targets[pressure.current]);
+        pressure.swap();
+        chebyshevIteration++;
+    }
+}
+
+void FluidSimulation::setMultigridSettings(const MultigridSettings& settings) {
+    if (settings.minLevelSize != multigridSettings.minLevelSize) {
+        deleteMultigridLevels();
+    }
+    multigridSettings = settings;
+}
+
+void FluidSimulation::setPressureOptions(const PressureOptions& options) {
+    setPressureSolver(options.solver);
+    setAdaptivePressure(options.adaptive);
+    setPressureWarmStart(options.warmStart);
+    setPressurePath(options.path);
+    if (options.iterations > 0) {
+        if (options.solver == PressureSolver::Multigrid) {
+            MultigridSettings settings = multigridSettings;
+            settings.cycles = options.iterations;
+            setMultigridSettings(settings);
+        }
+        else {
+            setPressureIterations(options.iterations);
+        }
+    }
+}
+
+void FluidSimulation::createMultigridLevels() {
+    MultigridLevel finest;
+    finest.width = gridW;
+    finest.height = gridH;
+    finest.pressure = pressure;
+    finest.rhs = divergence;
+    finest.residual = residual;
+    finest.constants = levelConstantsBuffer;
+    multigridLevels.push_back(finest);
+
+    int minSize = std::max(multigridSettings.minLevelSize, 1);
+    while (true) {
+        const MultigridLevel& fine = multigridLevels.back();
+        if (fine.width / 2 < minSize || fine.height / 2 < minSize) break;
+
+        MultigridLevel level;
+        level.width = (fine.width + 1) / 2;
+        level.height = (fine.height + 1) / 2;
+        level.pressure.create(level.width, level.height, pressureFormat.internalFormat, pressureFormat.format, GL_FLOAT);
+        level.rhs.create(level.width, level.height, GL_R32F, GL_RED, GL_FLOAT);
+        level.residual.create(level.width, level.height, GL_R32F, GL_RED, GL_FLOAT);
+        // Grid spacing of this level in finest-level texels
+        float h = (float)(1 << multigridLevels.size());
+        level.constants = createLevelConstants(level.width, level.height, h * h);
+        multigridLevels.push_back(level);
+    }
+}
+
+void FluidSimulation::deleteMultigridLevels() {
+    for (size_t i = 0; i < multigridLevels.size(); i++) {
+        MultigridLevel& level = multigridLevels[i];
+        if (i > 0) {
+            level.pressure.destroy();
+            level.rhs.destroy();
+            level.residual.destroy();
+            glDeleteBuffers(1, &level.constants);
+        }
+    }
+    multigridLevels.clear();
+}
+
+void FluidSimulation::smoothLevel(int level, int iterations) {
+    MultigridLevel& lv = multigridLevels[level];
+
+    smoothShader->use();
+    smoothShader->setFloat("omega", multigridSettings.omega);
+    bindLevelConstants(lv.constants);
+    glBindVertexArray(quadVAO);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, lv.rhs.texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    for (int i = 0; i < iterations; i++) {
+        lv.pressure.write().bind();
+        glBindTexture(GL_TEXTURE_2D, lv.pressure.read().texture);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+
+        lv.pressure.swap();
+        unbindFramebuffer();
+    }
+}
+
+void FluidSimulation::multigridCycle(int level) {
+    MultigridLevel& lv = multigridLevels[level];
+    if (level + 1 == (int)multigridLevels.size()) {
+        smoothLevel(level, multigridSettings.coarseIterations);
+        return;
+    }
+
+    smoothLevel(level, multigridSettings.preSmooth);
+
+    computeResidual(lv.pressure.read().texture, lv.rhs.texture, lv.residual, lv.constants);
+
+    // Restrict it into the coarse right-hand side and solve for the correction
+    MultigridLevel& coarse = multigridLevels[level + 1];
+    coarse.rhs.bind();
+    restrictShader->use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, lv.residual.texture);
     glBindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
+    unbindFramebuffer();
+
+    coarse.pressure.read().bind();
+    glClear(GL_COLOR_BUFFER_BIT);
+    unbindFramebuffer();
+
+    int visits = multigridSettings.cycle == MultigridCycle::W ? 2 : 1;
+    for (int i = 0; i < visits; i++) {
+        multigridCycle(level + 1);
+    }
 
-    currentVel = 1 - currentVel;
+    // Prolongate the correction back onto this level
+    lv.pressure.write().bind();
+    prolongateShader->use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, lv.pressure.read().texture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, coarse.pressure.read().texture);
+    glBindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    lv.pressure.swap();
     unbindFramebuffer();
+
+    smoothLevel(level, multigridSettings.postSmooth);
 }
 
-void FluidSimulation::subtractGradient() {
-    bindFramebuffer(velocityTextures[1 - currentVel]);
+void FluidSimulation::multigridCycles(int count) {
+    if (multigridLevels.empty()) {
+        createMultigridLevels();
+    }
 
-    gradientShader->use();
-    gradientShader->setVec2("texelSize", 1.0f / gridW, 1.0f / gridH);
+    // The warm start may have rotated the finest level's targets
+    multigridLevels[0].pressure = pressure;
+    multigridLevels[0].rhs = divergence;
+    multigridLevels[0].residual = residual;
+    for (int i = 0; i < count; i++) {
+        multigridCycle(0);
+    }
+    pressure.current = multigridLevels[0].pressure.current;
+}
+
+void FluidSimulation::setPressureSolver(PressureSolver solver) {
+    if (solver != pressureSolver) {
+        pressureSolver = solver;
+        pressureIterationBudget = solver == PressureSolver::Multigrid ? multigridSettings.cycles : pressureIterations;
+    }
+}
+
+void FluidSimulation::setPressureIterations(int iterations) {
+    pressureIterations = iterations;
+    if (pressureSolver != PressureSolver::Multigrid) {
+        pressureIterationBudget = std::max(1, std::min(iterations, adaptivePressure.maxIterations));
+    }
+}
+
+void FluidSimulation::setPressureWarmStart(PressureWarmStart mode) {
+    if (mode != pressureWarmStart) {
+        pressureWarmStart = mode;
+        // The history is only recorded while extrapolating, so start over
+        pressureHistoryCount = 0;
+    }
+}
+
+void FluidSimulation::setAdaptivePressure(const AdaptivePressureSettings& settings) {
+    adaptivePressure = settings;
+    pressureIterationBudget = std::max(1, std::min(pressureIterationBudget, settings.maxIterations));
+}
+
+void FluidSimulation::computeResidual(GLuint pressure, GLuint rhs, const RenderTarget& target, GLuint constants) {
+    target.bind();
+
+    residualShader->use();
+    bindLevelConstants(constants);
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, velocityTextures[currentVel]);
-    gradientShader->setInt("velocity", 0);
+    glBindTexture(GL_TEXTURE_2D, pressure);
 
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, pressureTextures[currentPressure]);
-    gradientShader->setInt("pressure", 1);
+    glBindTexture(GL_TEXTURE_2D, rhs);
 
     glBindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 
-    currentVel = 1 - currentVel;
     unbindFramebuffer();
 }
 
-void FluidSimulation::advectDye(float dt) {
-    bindFramebuffer(dyeTextures[1 - currentDye]);
+void FluidSimulation::requestResidualCheck(int iterations, bool last) {
+    GpuProfiler::Scope scope(profiler, "residual check");
+    computeResidual(pressure.read().texture, divergence.texture, residual, levelConstantsBuffer);
+    residualReduction->request(residual.texture, GpuReduction::Mode::Scalar);
+
+    ResidualCheck check;
+    check.frame = frameIndex;
+    check.iterations = iterations;
+    check.last = last;
+    residualChecks.push_back(check);
+}
+
+bool FluidSimulation::pollResidualChecks() {
+    bool converged = false;
+    int minIterations = pressureSolver == PressureSolver::Multigrid ? 1 : adaptivePressure.minIterations;
+    int step = pressureSolver == PressureSolver::Multigrid ? 1 : std::max(adaptivePressure.checkInterval, 1);
+
+    ReductionResult result;
+    while (!residualChecks.empty() && residualReduction->poll(result)) {
+        ResidualCheck check = residualChecks.front();
+        residualChecks.pop_front();
+        // The pure-Neumann problem cannot remove the mean of the residual, so
+        // convergence is measured about it
+        lastPressureResidual = result.deviation();
+
+        if (lastPressureResidual <= adaptivePressure.tolerance) {
+            // Checks arrive in order, so the first one under tolerance is the
+            // fewest iterations that frame needed
+            if (check.iterations < pressureIterationBudget) {
+                pressureIterationBudget = std::max(minIterations, check.iterations);
+            }
+            if (check.frame == frameIndex) {
+                converged = true;
+            }
+            unsigned age = frameIndex - check.frame;
+            if (age < 32) {
+                convergedFrames |= 1u << age;
+            }
+        }
+        else if (check.last && check.iterations >= pressureIterationBudget) {
+            pressureIterationBudget = std::min(adaptivePressure.maxIterations, pressureIterationBudget + step);
+        }
+    }
+    return converged;
+}
+
+double PressureConvergence::decadesPerMillisecond() const {
+    if (milliseconds <= 0.0 || initialResidual <= 0.0f || finalResidual <= 0.0f) return 0.0;
+    return std::log10((double)initialResidual / finalResidual) / milliseconds;
+}
+
+PressureConvergence FluidSimulation::measurePressureConvergence(PressureSolver solver, int iterations) {
+    if (!measureReduction) {
+        // Kept apart from the adaptive checks, whose results are matched in order
+        measureReduction = std::make_unique<GpuReduction>();
+        measureReduction->init(gridW, gridH);
+    }
+
+    PressureSolver savedSolver = pressureSolver;
+    pressureSolver = solver;
+
+    PressureConvergence convergence;
+    convergence.iterations = iterations;
+    ReductionResult result;
+
+    // Every solver is measured on the compatible problem. With a zero guess
+    // the residual is then the divergence itself.
+    removeDivergenceMean();
+    pressure.read().bind();
+    glClear(GL_COLOR_BUFFER_BIT);
+    unbindFramebuffer();
+    measureReduction->request(divergence.texture, GpuReduction::Mode::Scalar);
+    measureReduction->wait(result);
+    convergence.initialResidual = result.deviation();
+
+    // Fenced with glFinish rather than a timer query, which does not cover
+    // compute dispatches on every driver
+    chebyshevIteration = 0;
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    runPressureIterations(iterations);
+    glFinish();
+    convergence.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    computeResidual(pressure.read().texture, divergence.texture, residual, levelConstantsBuffer);
+    measureReduction->request(residual.texture, GpuReduction::Mode::Scalar);
+    measureReduction->wait(result);
+    convergence.finalResidual = result.deviation();
+
+    pressureSolver = savedSolver;
+    pressureHistoryCount = 0;
+    return convergence;
+}
+
+void FluidSimulation::computeVorticity() {
+    GpuProfiler::Scope scope(profiler, "vorticity");
+    vorticity.bind();
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, velocity.read().texture);
+
+    drawField(*vorticityShader);
+
+    unbindFramebuffer();
+}
+
+void FluidSimulation::applyVorticityConfinement() {
+    GpuProfiler::Scope scope(profiler, "confinement");
+    velocity.write().bind();
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, velocity.read().texture);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, vorticity.texture);
 
-    advectShader->use();
-    advectShader->setFloat("dt", dt * 50.0f);
-    advectShader->setVec2("texelSize", 1.0f, 1.0f);
+    drawField(*confinementShader);
+
+    velocity.swap();
+    unbindFramebuffer();
+}
+
+void FluidSimulation::applyConfinementAndDivergence() {
+    GpuProfiler::Scope scope(profiler, "confinement+divergence");
+    getTargetPair(velocity.write(), divergence).bind();
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, dyeTextures[currentDye]);
-    advectShader->setInt("field", 0);
+    glBindTexture(GL_TEXTURE_2D, velocity.read().texture);
 
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, velocityTextures[currentVel]);
-    advectShader->setInt("velocity", 1);
+    glBindTexture(GL_TEXTURE_2D, vorticity.texture);
 
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    drawField(*confinementDivergenceShader);
 
-    currentDye = 1 - currentDye;
+    velocity.swap();
     unbindFramebuffer();
 }
 
-void FluidSimulation::addForce(float x, float y, float fx, float fy) {
-    bindFramebuffer(velocityTextures[1 - currentVel]);
+void FluidSimulation::subtractGradient() {
+    GpuProfiler::Scope scope(profiler, "gradient");
+    velocity.write().bind();
 
-    splatShader->use();
-    splatShader->setVec2("point", x * gridW, y * gridH);
-    splatShader->setVec3("color", fx, fy, 0.0f);
-    splatShader->setFloat("radius", 200.0f);
-    splatShader->setFloat("strength", 0.05f);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, velocity.read().texture);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, pressure.read().texture);
+
+    drawField(*gradientShader);
+
+    velocity.swap();
+    unbindFramebuffer();
+}
+
+void FluidSimulation::advectDye() {
+    GpuProfiler::Scope scope(profiler, "advect dye");
+    dye.write().bind();
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, velocityTextures[currentVel]);
-    splatShader->setInt("base", 0);
+    glBindTexture(GL_TEXTURE_2D, dye.read().texture);
 
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, velocity.read().texture);
 
-    currentVel = 1 - currentVel;
+    drawField(*advectShader);
+
+    dye.swap();
     unbindFramebuffer();
 }
 
+void FluidSimulation::setDyeResolution(int width, int height) {
+    dyeW = width > 0 ? width : gridW;
+    dyeH = height > 0 ? height : gridH;
+}
+
+Splat FluidSimulation::forceSplat(float x, float y, float fx, float fy) {
+    Splat splat;
+    splat.x = x;
+    splat.y = y;
+    splat.radius = 200.0f;
+    splat.strength = 0.05f;
+    splat.r = fx;
+    splat.g = fy;
+    return splat;
+}
+
+Splat FluidSimulation::dyeSplat(float x, float y, float r, float g, float b) {
+    Splat splat;
+    splat.x = x;
+    splat.y = y;
+    splat.radius = 100.0f;
+    splat.strength = 0.8f;
+    splat.r = r;
+    splat.g = g;
+    splat.b = b;
+    return splat;
+}
+
+void FluidSimulation::addForce(float x, float y, float fx, float fy) {
+    queueForce(forceSplat(x, y, fx, fy));
+}
+
 void FluidSimulation::addDye(float x, float y, float r, float g, float b) {
-    bindFramebuffer(dyeTextures[1 - currentDye]);
+    queueDye(dyeSplat(x, y, r, g, b));
+}
 
-    splatShader->use();
-    splatShader->setVec2("point", x * gridW, y * gridH);
-    splatShader->setVec3("color", r, g, b);
-    splatShader->setFloat("radius", 100.0f);
-    splatShader->setFloat("strength", 0.8f);
+void FluidSimulation::flushSplats() {
+    if (pendingForces.empty() && pendingDye.empty()) return;
+    GpuProfiler::Scope scope(profiler, "splats");
+    applySplats(velocity, pendingForces);
+    applySplats(dye, pendingDye);
+}
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, dyeTextures[currentDye]);
-    splatShader->setInt("base", 0);
+void FluidSimulation::clearFields() {
+    pendingForces.clear();
+    pendingDye.clear();
+    const DoubleRenderTarget* fields[3] = { &velocity, &pressure, &dye };
+    for (const DoubleRenderTarget* field : fields) {
+        for (const RenderTarget& target : field->targets) {
+            target.bind();
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+    }
+    unbindFramebuffer();
+    pressureHistoryCount = 0;
+    previousDyeValid = false;
+}
 
+void FluidSimulation::applySplats(DoubleRenderTarget& target, std::vector<Splat>& splats) {
+    if (splats.empty()) return;
+
+    // Splats are blended straight into the current field: only the texels
+    // under their footprints are touched, so there is no ping-pong copy.
+    // Sparse passes skip still tiles in both buffers, so there they go into
+    // both.
+    const RenderTarget& field = target.read();
+    const RenderTarget* fields[2] = { &target.read(), &target.write() };
+    int fieldCount = tileActivity ? 2 : 1;
+    splatShader->use();
+    splatShader->setVec2("targetTexelSize", 1.0f / field.width, 1.0f / field.height);
     glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
 
-    currentDye = 1 - currentDye;
+    // Radii are in velocity texels; a finer field scales the footprint
+    float radiusScale = ((float)field.width / gridW) * ((float)field.height / gridH);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    std::vector<SplatConstants> batch;
+    for (size_t first = 0; first < splats.size(); first += maxSplatsPerPass) {
+        size_t count = std::min(splats.size() - first, (size_t)maxSplatsPerPass);
+        batch.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            const Splat& splat = splats[first + i];
+            SplatConstants& constants = batch[i];
+            constants.pointRadius[0] = splat.x * field.width;
+            constants.pointRadius[1] = splat.y * field.height;
+            constants.pointRadius[2] = splat.radius * radiusScale;
+            constants.pointRadius[3] = splat.strength;
+            constants.color[0] = splat.r;
+            constants.color[1] = splat.g;
+            constants.color[2] = splat.b;
+            constants.color[3] = 0.0f;
+        }
+
+        // The block always spans MAX_SPLATS entries; the buffer is orphaned
+        // so a batch never waits on the pass that read the previous one
+        glBindBuffer(GL_UNIFORM_BUFFER, splatBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, maxSplatsPerPass * sizeof(SplatConstants), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(SplatConstants), batch.data());
+        glBindBufferBase(GL_UNIFORM_BUFFER, splatsBinding, splatBuffer);
+
+        for (int i = 0; i < fieldCount; i++) {
+            fields[i]->bind();
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)count);
+        }
+    }
+    glDisable(GL_BLEND);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
     unbindFramebuffer();
+    splats.clear();
 }
 
 void FluidSimulation::step(float dt) {
-    advectVelocity(dt);
+    TRACE_ZONE("step");
+    flushSplats();
+    updateFrameConstants(dt);
+    if (tileActivity) {
+        updateActiveTiles();
+    }
+    advectVelocity();
     computeVorticity();
-    applyVorticityConfinement(dt);
-    computeDivergence();
-    solvePressure(20);
+    if (fusedPasses) {
+        applyConfinementAndDivergence();
+    }
+    else {
+        applyVorticityConfinement();
+        computeDivergence();
+    }
+    solvePressure(pressureSolver == PressureSolver::Multigrid ? multigridSettings.cycles : pressureIterations);
     subtractGradient();
-    advectDye(dt);
+    advectDye();
+    previousDyeValid = true;
+    if (velocityMonitoring) {
+        monitorVelocity();
+    }
+}
+
+void FluidSimulation::monitorVelocity() {
+    GpuProfiler::Scope scope(profiler, "max |u|");
+    if (!velocityReduction) {
+        velocityReduction = std::make_unique<GpuReduction>();
+        velocityReduction->init(gridW, gridH);
+    }
+
+    // At most one reduction is in flight: a new one is queued once the last
+    // has been read back, so the value lags a step or two and the CPU never
+    // waits on the GPU for it
+    ReductionResult result;
+    while (velocityReduction->poll(result)) {
+        maxVelocity = result.maxValue;
+    }
+    if (velocityReduction->pending() == 0) {
+        velocityReduction->request(velocity.read().texture, GpuReduction::Mode::Length);
+    }
 }
 
-void FluidSimulation::render(int windowWidth, int windowHeight) {
+float FluidSimulation::getStableTimestep(float courant) const {
+    if (maxVelocity < 0.0f) return 0.0f;
+    // A step moves a texel by maxVelocity * advectionScale * dt in uv units,
+    // i.e. that times the grid size in cells
+    float cellsPerSecond = maxVelocity * advectionScale * std::max(gridW, gridH);
+    if (cellsPerSecond <= 0.0f) return std::numeric_limits<float>::max();
+    return courant / cellsPerSecond;
+}
+
+void FluidSimulation::render(int windowWidth, int windowHeight, float interpolation) {
+    GpuProfiler::Scope scope(profiler, "display");
     glViewport(0, 0, windowWidth, windowHeight);
     glClear(GL_COLOR_BUFFER_BIT);
 
+    bool blend = previousDyeValid && interpolation < 1.0f;
     displayShader->use();
+    displayShader->setFloat("blend", blend ? std::max(interpolation, 0.0f) : 1.0f);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, dyeTextures[currentDye]);
-    displayShader->setInt("tex", 0);
+    glBindTexture(GL_TEXTURE_2D, dye.read().texture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, blend ? dye.write().texture : dye.read().texture);
 
     glBindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+void FluidSimulation::finish() {
+    glFinish();
+}
+
+void FluidSimulation::readVelocity(std::vector<float>& out) {
+    flushSplats();
+    out.resize((size_t)gridW * gridH * 2);
+    glBindTexture(GL_TEXTURE_2D, velocity.read().texture);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_FLOAT, out.data());
+}
+
+void FluidSimulation::readDye(std::vector<float>& out) {
+    flushSplats();
+    out.resize((size_t)dyeW * dyeH * 3);
+    glBindTexture(GL_TEXTURE_2D, dye.read().texture);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_FLOAT, out.data());
 }
\ No newline at end of file
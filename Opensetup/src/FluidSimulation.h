@@ -2,32 +2,292 @@
 #define FLUIDSIMULATION_H
 
 #include <glad/glad.h>
+#include <deque>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 #include "Shader.h"
+#include "FluidSolver.h"
+#include "GpuProfiler.h"
+#include "GpuReduction.h"
+#include "RenderTarget.h"
+#include "TileActivity.h"
 
-class FluidSimulation {
+enum class PressureSolver {
+    Jacobi,
+    RedBlackSOR,        // checkerboard Gauss-Seidel with over-relaxation
+    ChebyshevJacobi,    // Jacobi with Chebyshev semi-iterative weights
+    Multigrid
+};
+
+enum class MultigridCycle {
+    V,
+    W
+};
+
+struct MultigridSettings {
+    MultigridCycle cycle = MultigridCycle::V;
+    int cycles = 2;             // cycles per step
+    int preSmooth = 2;          // damped Jacobi sweeps before restriction
+    int postSmooth = 2;         // damped Jacobi sweeps after prolongation
+    int coarseIterations = 20;  // sweeps on the coarsest level
+    int minLevelSize = 4;       // stop coarsening below this many texels
+    float omega = 0.8f;         // Jacobi damping factor
+};
+
+// Where the Jacobi pressure loop runs. The compute path needs GL 4.3 and
+// falls back to fragment passes without it.
+enum class PressurePath {
+    Auto,       // time both once at init and keep the faster
+    Compute,    // tiled compute dispatches, several sweeps per dispatch
+    Fragment    // one full-screen pass per sweep
+};
+
+// Parameters of the accelerated relaxation solvers. Zero picks the value
+// derived from the Jacobi spectral radius of the grid,
+// rho = (1 + cos(pi / max(width, height))) / 2.
+struct RelaxationSettings {
+    float sorOmega = 0.0f;          // over-relaxation factor, 2 / (1 + sqrt(1 - rho^2))
+    float spectralRadius = 0.0f;    // rho used for the Chebyshev weights
+};
+
+// Time (fenced with glFinish) and residual reduction of one pressure solve
+// from a zero guess
+struct PressureConvergence {
+    int iterations = 0;
+    double milliseconds = 0.0;
+    float initialResidual = 0.0f;
+    float finalResidual = 0.0f;
+
+    // Orders of magnitude of residual reduction per millisecond
+    double decadesPerMillisecond() const;
+};
+
+// Storage formats of the simulated fields. Shaders always compute in fp32;
+// only the texels stored between passes are narrowed, which halves the
+// bytes the bandwidth-bound passes move. Divergence and residuals stay fp32.
+enum class FieldPrecision {
+    Full,       // RG32F velocity, R32F pressure, RGBA32F dye
+    Half,       // RG16F velocity, R16F pressure, RGBA16F dye
+    Packed      // as Half with R11F_G11F_B10F dye (unsigned, 4 bytes a texel)
+};
+
+// One gaussian impulse, exp(-d^2 / radius) * strength with d in velocity
+// grid texels (on a finer dye field the footprint is scaled to match)
+struct Splat {
+    float x = 0.0f;         // position in [0, 1]
+    float y = 0.0f;
+    float radius = 100.0f;
+    float strength = 1.0f;
+    float r = 0.0f;         // dye colour, or the force in r and g
+    float g = 0.0f;
+    float b = 0.0f;
+};
+
+// Initial guess for the pressure solve
+enum class PressureWarmStart {
+    Zero,           // clear every step
+    Previous,       // reuse the last step's pressure
+    Extrapolate     // p(n-1) + 0.5 * (p(n-1) - p(n-2)) once both met the tolerance
+};
+
+// Cumulative pressure solve counters, for comparing solvers and warm starts
+// at equal residual
+struct PressureStats {
+    long long steps = 0;
+    long long iterations = 0;
+
+    double iterationsPerStep() const { return steps > 0 ? (double)iterations / steps : 0.0; }
+};
+
+// Residual-driven pressure iteration count. Every checkInterval iterations
+// (Jacobi sweeps, or multigrid cycles) the mean-free RMS of div - laplacian(p) is
+// reduced on the GPU and read back asynchronously; the solve stops once a
+// result for the current frame meets the tolerance, and the per-frame
+// iteration budget adapts to results that arrive late.
+struct AdaptivePressureSettings {
+    bool enabled = false;
+    float tolerance = 1e-5f;
+    int checkInterval = 5;
+    int minIterations = 5;
+    int maxIterations = 100;
+};
+
+// Sparse stepping. Advection, vorticity, confinement, divergence and the
+// gradient subtraction only draw the 16x16 tiles that hold a texel with
+// |u| above the threshold, plus `dilation` tiles around them, so the still
+// parts of the domain cost (almost) nothing. The pressure solve stays
+// full-domain. Needs GL 4.3, and falls back to full passes without it.
+struct SparseSettings {
+    bool enabled = false;
+    float velocityThreshold = 1e-4f;
+    int dilation = 1;
+};
+
+// The pressure solve configuration chosen on the command line, applied in
+// one go by FluidSimulation::setPressureOptions()
+struct PressureOptions {
+    PressureSolver solver = PressureSolver::Jacobi;
+    AdaptivePressureSettings adaptive;
+    PressureWarmStart warmStart = PressureWarmStart::Zero;
+    PressurePath path = PressurePath::Auto;
+    int iterations = 0;     // sweeps per step, or multigrid cycles; 0 keeps the default
+};
+
+class FluidSimulation : public FluidSolver {
 public:
     FluidSimulation(int width, int height);
     ~FluidSimulation();
 
-    void init();
-    void step(float dt);
-    void render(int windowWidth, int windowHeight);
-    void addForce(float x, float y, float fx, float fy);
-    void addDye(float x, float y, float r, float g, float b);
+    void init() override;
+    void step(float dt) override;
+    // Draws the dye blended from the state before the last step towards the
+    // current one; 1 shows the current state. A fixed-timestep caller passes
+    // its accumulated fraction of a step (see SimulationClock).
+    void render(int windowWidth, int windowHeight, float interpolation = 1.0f);
+    void addForce(float x, float y, float fx, float fy) override;
+    void addDye(float x, float y, float r, float g, float b) override;
+
+    void finish() override;
+    void readVelocity(std::vector<float>& out) override;
+    void readDye(std::vector<float>& out) override;
+
+    // Impulses are queued and applied together, one instanced draw of
+    // footprint quads per field for up to 256 splats, at the start of the
+    // next step (or readback). Rendering leaves them queued, so a frame
+    // without a step adds nothing.
+    // addForce() and addDye() queue a splat with the default radius and
+    // strength, as built by forceSplat() and dyeSplat().
+    static Splat forceSplat(float x, float y, float fx, float fy);
+    static Splat dyeSplat(float x, float y, float r, float g, float b);
+    void queueForce(const Splat& splat) { pendingForces.push_back(splat); }
+    void queueDye(const Splat& splat) { pendingDye.push_back(splat); }
+    void flushSplats();
+    // Zeroes velocity, pressure and dye, for scenarios that start from rest
+    // instead of the initial vortex
+    void clearFields();
+
+    int getWidth() const { return gridW; }
+    int getHeight() const { return gridH; }
+    // The dye can be finer (or coarser) than the velocity grid, so the
+    // projection runs at low resolution while the image keeps its detail.
+    // Defaults to the grid size; takes effect at init().
+    void setDyeResolution(int width, int height);
+    int getDyeWidth() const { return dyeW; }
+    int getDyeHeight() const { return dyeH; }
+
+    // Takes effect at init()
+    void setFieldPrecision(FieldPrecision precision) { fieldPrecision = precision; }
+    FieldPrecision getFieldPrecision() const { return fieldPrecision; }
+    // Bytes of field textures at the current size, excluding multigrid
+    // levels and reductions
+    size_t getFieldMemory() const;
+
+    // Takes effect at init()
+    void setSparseSettings(const SparseSettings& settings) { sparseSettings = settings; }
+    const SparseSettings& getSparseSettings() const { return sparseSettings; }
+    bool isSparse() const { return tileActivity != nullptr; }
+    int getTileCount() const;
+    // Tiles stepped by the last step (every tile unless sparse). Reads the
+    // count back, so it stalls until the step has run.
+    int readActiveTiles() const;
+
+    // Changes the grid size of an initialised simulation. Velocity, pressure
+    // and dye are resampled bilinearly (the dye keeps its ratio to the grid),
+    // the scratch fields and solver state are reallocated, and no program is
+    // rebuilt. Pressure is only a warm start, so its scale is not adjusted.
+    void resize(int width, int height);
+
+    void setPressureSolver(PressureSolver solver);
+    PressureSolver getPressureSolver() const { return pressureSolver; }
+    void setMultigridSettings(const MultigridSettings& settings);
+    void setPressureOptions(const PressureOptions& options);
+    const MultigridSettings& getMultigridSettings() const { return multigridSettings; }
+    // Also restarts the adaptive budget from this count (unless multigrid)
+    void setPressureIterations(int iterations);
+    int getPressureIterations() const { return pressureIterations; }
+    // Runs confinement and divergence as one two-target pass after the
+    // vorticity pass, instead of two separate passes. Off by default: it
+    // moves fewer bytes but evaluates the force five times per texel.
+    void setFusedPasses(bool enabled) { fusedPasses = enabled; }
+    bool getFusedPasses() const { return fusedPasses; }
+
+    // Takes effect at init()
+    void setPressurePath(PressurePath path) { pressurePath = path; }
+    bool isUsingComputeShaders() const { return useComputePressure; }
+
+    void setRelaxationSettings(const RelaxationSettings& settings) { relaxationSettings = settings; }
+    const RelaxationSettings& getRelaxationSettings() const { return relaxationSettings; }
+    void setAdaptivePressure(const AdaptivePressureSettings& settings);
+    const AdaptivePressureSettings& getAdaptivePressure() const { return adaptivePressure; }
+
+    void setPressureWarmStart(PressureWarmStart mode);
+    PressureWarmStart getPressureWarmStart() const { return pressureWarmStart; }
+    const PressureStats& getPressureStats() const { return pressureStats; }
+    void resetPressureStats() { pressureStats = PressureStats(); }
+
+    // Runs one solve of the given kind on the current divergence and measures
+    // it. Clobbers the pressure field and warm-start history, so it is meant
+    // for benchmarks between steps.
+    PressureConvergence measurePressureConvergence(PressureSolver solver, int iterations);
+
+    // Reduces max |u| on the GPU after a step and reads it back
+    // asynchronously, so getMaxVelocity() lags a step or two but never stalls
+    void setVelocityMonitoring(bool enabled) { velocityMonitoring = enabled; }
+    bool getVelocityMonitoring() const { return velocityMonitoring; }
+    // Latest max |u| read back, -1 until one arrives
+    float getMaxVelocity() const { return maxVelocity; }
+    // Largest dt that moves the fastest texel at most `courant` cells per
+    // step, or 0 while no max |u| is known
+    float getStableTimestep(float courant) const;
+
+    // Times each pass of step(), render() and the splats into the profiler's
+    // current frame; null turns it off. The caller owns the profiler and
+    // brackets its frames.
+    void setProfiler(GpuProfiler* profiler) { this->profiler = profiler; }
+
+    // Iterations (relaxation sweeps or multigrid cycles) run by the last
+    // step, and the most recent residual RMS read back (-1 until one arrives).
+    // A red-black SOR sweep is both half-passes.
+    int getLastPressureIterations() const { return lastPressureIterations; }
+    float getLastPressureResidual() const { return lastPressureResidual; }
 
 private:
     int gridW, gridH;
+    int dyeW, dyeH;
+
+    // Texture formats picked from the precision at init()
+    struct FieldFormat {
+        GLenum internalFormat;
+        GLenum format;
+        int bytesPerTexel;
+    };
+    FieldPrecision fieldPrecision;
+    FieldFormat velocityFormat;
+    FieldFormat pressureFormat;
+    FieldFormat dyeFormat;
 
-    // Textures
-    GLuint velocityTextures[2];
-    GLuint dyeTextures[2];
-    GLuint pressureTextures[2];
-    GLuint divergenceTexture;
-    GLuint vorticityTexture;
+    // Render targets, each with its own framebuffer
+    DoubleRenderTarget velocity;
+    DoubleRenderTarget dye;
+    DoubleRenderTarget pressure;
+    RenderTarget pressureHistory;
+    RenderTarget chebyshevPrevious;     // p(k-1) of the Chebyshev recurrence
+    RenderTarget divergence;
+    RenderTarget vorticity;
+    RenderTarget residual;
 
-    // Framebuffers
-    GLuint framebuffers[2];
+    // Two-target framebuffers, created on first use
+    std::vector<RenderTargetPair> targetPairs;
+
+    // Uniform buffers for the std140 blocks in ShaderSources.h: per-step
+    // constants, and the finest level's grid constants
+    GLuint frameConstantsBuffer;
+    GLuint levelConstantsBuffer;
+    GLuint splatBuffer;
+
+    std::vector<Splat> pendingForces;
+    std::vector<Splat> pendingDye;
 
     // Shaders
     std::unique_ptr<Shader> advectShader;
@@ -38,32 +298,127 @@ private:
     std::unique_ptr<Shader> displayShader;
     std::unique_ptr<Shader> vorticityShader;
     std::unique_ptr<Shader> confinementShader;
+    std::unique_ptr<Shader> smoothShader;
+    std::unique_ptr<Shader> residualShader;
+    std::unique_ptr<Shader> restrictShader;
+    std::unique_ptr<Shader> prolongateShader;
+    std::unique_ptr<Shader> extrapolateShader;
+    std::unique_ptr<Shader> removeMeanShader;
+    std::unique_ptr<Shader> sorShader;
+    std::unique_ptr<Shader> chebyshevShader;
+    std::unique_ptr<Shader> confinementDivergenceShader;
+    std::unique_ptr<Shader> jacobiTiledShader;     // null without GL 4.3
+    // tile_vs builds of the passes above that sparse stepping limits to the
+    // active tiles, keyed by the full-grid program
+    std::unordered_map<const Shader*, std::unique_ptr<Shader>> tileVariants;
 
     // VAO
     GLuint quadVAO;
 
-    // Buffer indices
-    int currentVel;
-    int currentDye;
-    int currentPressure;
+    bool fusedPasses;
+    // dye.write() still holds the input of the last dye advection, which is
+    // the previous state for render interpolation
+    bool previousDyeValid;
+
+    // Multigrid pyramid. Level 0 aliases pressure/divergence/residual,
+    // coarser levels own their targets and are allocated on first use.
+    struct MultigridLevel {
+        int width, height;
+        DoubleRenderTarget pressure;
+        RenderTarget rhs;
+        RenderTarget residual;
+        GLuint constants;       // LevelConstants uniform buffer
+    };
+    std::vector<MultigridLevel> multigridLevels;
+    PressureSolver pressureSolver;
+    MultigridSettings multigridSettings;
+    int pressureIterations;
+    RelaxationSettings relaxationSettings;
+    PressurePath pressurePath;
+    bool useComputePressure;
+    int chebyshevIteration;     // position in the recurrence, restarts every solve
+    float chebyshevOmega;
+    PressureWarmStart pressureWarmStart;
+    PressureStats pressureStats;
+    int pressureHistoryCount;   // solves recorded, up to 2
+
+    // Adaptive pressure iteration state
+    struct ResidualCheck {
+        unsigned frame;
+        int iterations;
+        bool last;      // final check of its frame
+    };
+    std::unique_ptr<GpuReduction> residualReduction;
+    std::unique_ptr<GpuReduction> measureReduction;
+    std::deque<ResidualCheck> residualChecks;
+    AdaptivePressureSettings adaptivePressure;
+    unsigned frameIndex;
+    unsigned convergedFrames;   // bit k: the solve k frames back met the tolerance
+    int pressureIterationBudget;
+    int lastPressureIterations;
+    float lastPressureResidual;
+
+    SparseSettings sparseSettings;
+    std::unique_ptr<TileActivity> tileActivity;     // null unless sparse
+
+    GpuProfiler* profiler;
+
+    // CFL monitoring
+    std::unique_ptr<GpuReduction> velocityReduction;
+    bool velocityMonitoring;
+    float maxVelocity;
 
     // Private methods
     void createShaders();
-    void createTexturePair(GLuint textures[2], GLenum internalFormat, GLenum format, GLenum type);
-    void setupTexture(GLuint texture, GLenum internalFormat, GLenum format, GLenum type);
+    void finishShaders();
+    void updateFrameConstants(float dt);
+    GLuint createLevelConstants(int width, int height, float h2);
+    void bindLevelConstants(GLuint buffer);
     GLuint createQuadVAO();
     void initVelocityField();
 
-    void bindFramebuffer(GLuint texture);
+    void createScratchTargets();
+    void destroyScratchTargets();
+    void chooseFieldFormats();
+    static void resample(DoubleRenderTarget& field, int width, int height, const FieldFormat& format);
+
+    // Draws the pass over the whole grid, or its tile variant over the
+    // active tiles; the framebuffer and textures are bound by the caller
+    void drawField(const Shader& shader);
+    void updateActiveTiles();
+
+    const RenderTargetPair& getTargetPair(const RenderTarget& first, const RenderTarget& second);
     void unbindFramebuffer();
 
-    void advectVelocity(float dt);
-    void advectDye(float dt);
+    void advectVelocity();
+    void advectDye();
     void computeDivergence();
     void solvePressure(int iterations = 20);
+    void warmStartPressure();
+    void removeDivergenceMean();
+    // Writes the field minus its mean into the target
+    void subtractMean(GLuint field, const RenderTarget& target);
+    void runPressureIterations(int count);
+    void jacobiIterations(int count);
+    void jacobiIterationsTiled(int count);
+    void choosePressurePath();
+    void sorIterations(int count);
+    void chebyshevIterations(int count);
+    float spectralRadius() const;
+    void multigridCycles(int count);
+    void computeResidual(GLuint pressure, GLuint rhs, const RenderTarget& target, GLuint constants);
+    void requestResidualCheck(int iterations, bool last);
+    void monitorVelocity();
+    bool pollResidualChecks();
+    void createMultigridLevels();
+    void deleteMultigridLevels();
+    void multigridCycle(int level);
+    void smoothLevel(int level, int iterations);
     void computeVorticity();
-    void applyVorticityConfinement(float dt);
+    void applyVorticityConfinement();
+    void applyConfinementAndDivergence();
     void subtractGradient();
+    void applySplats(DoubleRenderTarget& target, std::vector<Splat>& splats);
 };
 
 #endif
\ No newline at end of file
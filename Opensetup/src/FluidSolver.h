@@ -0,0 +1,30 @@
+#ifndef FLUID_SOLVER_H
+#define FLUID_SOLVER_H
+
+#include <vector>
+
+// Advection moves a texel by velocity * advectionScale * dt in uv units, so
+// a speed of 1 crosses the domain in 1/50 s
+const float advectionScale = 50.0f;
+
+// Common interface for the simulation backends. FluidSimulation runs the step
+// pipeline as GLSL passes on the GPU; CpuFluidSimulation runs the same passes
+// natively over float arrays so the two can be compared.
+class FluidSolver {
+public:
+    virtual ~FluidSolver() = default;
+
+    virtual void init() = 0;
+    virtual void step(float dt) = 0;
+    virtual void addForce(float x, float y, float fx, float fy) = 0;
+    virtual void addDye(float x, float y, float r, float g, float b) = 0;
+
+    // Blocks until all queued work has completed (for timing)
+    virtual void finish() {}
+
+    // Row-major readback of the current fields: velocity is RG, dye is RGB
+    virtual void readVelocity(std::vector<float>& out) = 0;
+    virtual void readDye(std::vector<float>& out) = 0;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "FrameStats.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+DurationHistogram::DurationHistogram()
+    : counts(bucketCount, 0), count(0), maxMs(0.0), sumMs(0.0) {
+}
+
+int DurationHistogram::bucketIndex(uint64_t microseconds) {
+    if (microseconds < (uint64_t)linearBuckets) return (int)microseconds;
+    // Position of the top bit, 5 or more here
+    int top = 0;
+    for (uint64_t v = microseconds; v > 1; v >>= 1) top++;
+    int shift = top - subBucketBits;
+    int sub = (int)(microseconds >> shift) - (1 << subBucketBits);
+    return linearBuckets + (top - 5) * (1 << subBucketBits) + sub;
+}
+
+uint64_t DurationHistogram::bucketTop(int index) {
+    if (index < linearBuckets) return (uint64_t)index;
+    int top = (index - linearBuckets) / (1 << subBucketBits) + 5;
+    int sub = (index - linearBuckets) % (1 << subBucketBits) + (1 << subBucketBits);
+    int shift = top - subBucketBits;
+    return (((uint64_t)sub + 1) << shift) - 1;
+}
+
+void DurationHistogram::record(double milliseconds) {
+    double microseconds = std::max(milliseconds * 1000.0, 0.0);
+    uint64_t value = (uint64_t)std::min(std::llround(microseconds), (long long)INT64_MAX);
+    counts[bucketIndex(value)]++;
+    count++;
+    maxMs = std::max(maxMs, milliseconds);
+    sumMs += milliseconds;
+}
+
+void DurationHistogram::reset() {
+    std::fill(counts.begin(), counts.end(), 0u);
+    count = 0;
+    maxMs = 0.0;
+    sumMs = 0.0;
+}
+
+double DurationHistogram::getPercentile(double p) const {
+    if (count == 0) return 0.0;
+    // Nearest rank
+    long long rank = (long long)std::ceil(std::min(std::max(p, 0.0), 100.0) / 100.0 * count);
+    rank = std::max(rank, 1LL);
+    long long seen = 0;
+    for (int i = 0; i < bucketCount; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(bucketTop(i) * 1e-3, maxMs);
+        }
+    }
+    return maxMs;
+}
+
+FrameStats::FrameStats()
+    : budgetMs(1000.0 / 60.0), frameIndex(0), elapsedMs(0.0) {
+}
+
+bool FrameStats::openCsv(const std::string& path) {
+    csv.open(path);
+    if (!csv) return false;
+    csv << "frame,time_s,frame_ms,step_ms,render_ms,steps" << std::endl;
+    return true;
+}
+
+void FrameStats::record(const FrameSample& sample) {
+    Window* windows[2] = { &interval, &total };
+    for (Window* window : windows) {
+        window->frame.record(sample.frameMs);
+        window->step.record(sample.stepMs);
+        window->render.record(sample.renderMs);
+        window->steps += sample.steps;
+        if (sample.frameMs > budgetMs) window->misses++;
+    }
+
+    elapsedMs += sample.frameMs;
+    if (csv.is_open()) {
+        csv << frameIndex << "," << elapsedMs * 1e-3 << "," << sample.frameMs << "," << sample.stepMs << ","
+            << sample.renderMs << "," << sample.steps << "\n";
+    }
+    frameIndex++;
+}
+
+void FrameStats::print(std::ostream& out, const Window& window, double seconds) const {
+    long long frames = window.frame.getCount();
+    if (frames == 0) return;
+
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(1);
+    out << "FPS: " << frames / seconds << " | Steps/s: " << window.steps / seconds
+        << " | Over " << budgetMs << " ms: " << window.misses << " of " << frames
+        << " (" << 100.0 * window.misses / frames << "%)" << std::endl;
+
+    out << std::setprecision(2);
+    const char* names[3] = { "frame", "step", "render" };
+    const DurationHistogram* histograms[3] = { &window.frame, &window.step, &window.render };
+    for (int i = 0; i < 3; i++) {
+        const DurationHistogram& histogram = *histograms[i];
+        out << "  " << std::left << std::setw(7) << names[i] << std::right
+            << "p50 " << histogram.getPercentile(50.0) << "  p90 " << histogram.getPercentile(90.0)
+            << "  p99 " << histogram.getPercentile(99.0) << "  p99.9 " << histogram.getPercentile(99.9)
+            << "  max " << histogram.getMax() << " ms" << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void FrameStats::report(std::ostream& out, double seconds) {
+    print(out, interval, std::max(seconds, 1e-9));
+    interval = Window();
+    if (csv.is_open()) csv.flush();
+}
+
+void FrameStats::reportTotal(std::ostream& out) const {
+    if (total.frame.getCount() == 0) return;
+    out << "Whole run:" << std::endl;
+    print(out, total, std::max(elapsedMs * 1e-3, 1e-9));
+}
\ No newline at end of file
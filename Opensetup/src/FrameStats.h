@@ -0,0 +1,89 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Log-bucketed histogram of durations in the style of HdrHistogram. Values
+// are kept in microseconds; below 32 us every value has its own bucket, and
+// above that each power of two is split into 16 linear sub-buckets, so a
+// percentile is exact to within 1/16 (about 6%) from 1 us to hours in a
+// fixed, allocation-free table. Percentiles report the top of their bucket,
+// capped at the exact maximum.
+class DurationHistogram {
+public:
+    DurationHistogram();
+
+    void record(double milliseconds);
+    void reset();
+
+    long long getCount() const { return count; }
+    double getMax() const { return maxMs; }
+    double getMean() const { return count > 0 ? sumMs / count : 0.0; }
+    // p in [0, 100]
+    double getPercentile(double p) const;
+
+private:
+    static const int linearBuckets = 32;
+    static const int subBucketBits = 4;
+    static const int bucketCount = linearBuckets + (64 - 5) * (1 << subBucketBits);
+
+    std::vector<uint32_t> counts;
+    long long count;
+    double maxMs;
+    double sumMs;
+
+    static int bucketIndex(uint64_t microseconds);
+    static uint64_t bucketTop(int index);
+};
+
+// Per-frame timings of the interactive loop
+struct FrameSample {
+    double frameMs = 0.0;       // wall time since the previous frame
+    double stepMs = 0.0;        // CPU time submitting the frame's steps
+    double renderMs = 0.0;      // CPU time submitting the display pass
+    int steps = 0;
+};
+
+// Frame, step and render time distributions, reported as p50/p90/p99/p99.9
+// and max instead of averages, which hide the odd long frame. Each report
+// covers the frames since the last one; the whole run is kept too. Frames
+// over the budget are counted as misses.
+class FrameStats {
+public:
+    FrameStats();
+
+    void setBudget(double milliseconds) { budgetMs = milliseconds; }
+    double getBudget() const { return budgetMs; }
+    // Writes every frame's sample as a CSV row from now on
+    bool openCsv(const std::string& path);
+
+    void record(const FrameSample& sample);
+
+    // Prints the frames since the last report and starts a new one
+    void report(std::ostream& out, double seconds);
+    void reportTotal(std::ostream& out) const;
+
+private:
+    struct Window {
+        DurationHistogram frame;
+        DurationHistogram step;
+        DurationHistogram render;
+        long long misses = 0;
+        long long steps = 0;
+    };
+
+    double budgetMs;
+    Window interval;
+    Window total;
+    long long frameIndex;
+    double elapsedMs;
+    std::ofstream csv;
+
+    void print(std::ostream& out, const Window& window, double seconds) const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "GLExtensions.h"
+#include <cstring>
+#include <iostream>
+
+#ifndef GL_VERSION_4_1
+PFNGLGETPROGRAMBINARYPROC glext_glGetProgramBinary = nullptr;
+PFNGLPROGRAMBINARYPROC glext_glProgramBinary = nullptr;
+PFNGLPROGRAMPARAMETERIPROC glext_glProgramParameteri = nullptr;
+#endif
+
+#ifndef GL_VERSION_4_0
+PFNGLDRAWARRAYSINDIRECTPROC glext_glDrawArraysIndirect = nullptr;
+#endif
+
+#ifndef GL_KHR_parallel_shader_compile
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glext_glMaxShaderCompilerThreadsKHR = nullptr;
+#endif
+
+#ifndef GL_VERSION_4_3
+PFNGLDISPATCHCOMPUTEPROC glext_glDispatchCompute = nullptr;
+PFNGLBINDIMAGETEXTUREPROC glext_glBindImageTexture = nullptr;
+PFNGLMEMORYBARRIERPROC glext_glMemoryBarrier = nullptr;
+#endif
+
+namespace {
+    bool programBinaries = false;
+    bool parallelShaderCompile = false;
+    bool computeShaders = false;
+    bool indirectDraws = false;
+
+    bool hasExtension(const char* name) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+            if (extension && strcmp(extension, name) == 0) return true;
+        }
+        return false;
+    }
+}
+
+namespace GLExtensions {
+
+bool load(GLADloadproc loader) {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major == 0) {
+        std::cout << "Failed to query the OpenGL version" << std::endl;
+        return false;
+    }
+
+    programBinaries = false;
+    if (major > 4 || (major == 4 && minor >= 1) || hasExtension("GL_ARB_get_program_binary")) {
+        glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)loader("glGetProgramBinary");
+        glProgramBinary = (PFNGLPROGRAMBINARYPROC)loader("glProgramBinary");
+        glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)loader("glProgramParameteri");
+        // Drivers may expose the entry points with no formats to reload
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        programBinaries = glGetProgramBinary && glProgramBinary && glProgramParameteri && formats > 0;
+    }
+
+    // The ARB variant has the same semantics under another name
+    parallelShaderCompile = false;
+    glMaxShaderCompilerThreadsKHR = nullptr;
+    if (hasExtension("GL_KHR_parallel_shader_compile")) {
+        glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)loader("glMaxShaderCompilerThreadsKHR");
+    }
+    else if (hasExtension("GL_ARB_parallel_shader_compile")) {
+        glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)loader("glMaxShaderCompilerThreadsARB");
+    }
+    if (glMaxShaderCompilerThreadsKHR) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        parallelShaderCompile = true;
+    }
+
+    indirectDraws = false;
+    if (major >= 4) {
+        glDrawArraysIndirect = (PFNGLDRAWARRAYSINDIRECTPROC)loader("glDrawArraysIndirect");
+        indirectDraws = glDrawArraysIndirect != nullptr;
+    }
+
+    computeShaders = false;
+    if (major > 4 || (major == 4 && minor >= 3)) {
+        glDispatchCompute = (PFNGLDISPATCHCOMPUTEPROC)loader("glDispatchCompute");
+        glBindImageTexture = (PFNGLBINDIMAGETEXTUREPROC)loader("glBindImageTexture");
+        glMemoryBarrier = (PFNGLMEMORYBARRIERPROC)loader("glMemoryBarrier");
+        computeShaders = glDispatchCompute && glBindImageTexture && glMemoryBarrier;
+    }
+    return true;
+}
+
+bool hasProgramBinaries() {
+    return programBinaries;
+}
+
+bool hasParallelShaderCompile() {
+    return parallelShaderCompile;
+}
+
+bool hasComputeShaders() {
+    return computeShaders;
+}
+
+bool hasIndirectDraws() {
+    return indirectDraws;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+// OpenGL entry points beyond the 3.3 core profile glad was generated for.
+// GLExtensions::load() runs after gladLoadGLLoader() with the same loader;
+// each group is only loaded when the context supports it, and stays null
+// otherwise, so callers must check the has*() queries first.
+
+#ifndef GL_VERSION_4_1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH          0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS     0x87FE
+
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+extern PFNGLGETPROGRAMBINARYPROC glext_glGetProgramBinary;
+extern PFNGLPROGRAMBINARYPROC glext_glProgramBinary;
+extern PFNGLPROGRAMPARAMETERIPROC glext_glProgramParameteri;
+#define glGetProgramBinary glext_glGetProgramBinary
+#define glProgramBinary glext_glProgramBinary
+#define glProgramParameteri glext_glProgramParameteri
+#endif
+
+#ifndef GL_VERSION_4_0
+#define GL_DRAW_INDIRECT_BUFFER           0x8F3F
+
+typedef void (APIENTRYP PFNGLDRAWARRAYSINDIRECTPROC)(GLenum mode, const void* indirect);
+
+extern PFNGLDRAWARRAYSINDIRECTPROC glext_glDrawArraysIndirect;
+#define glDrawArraysIndirect glext_glDrawArraysIndirect
+#endif
+
+#ifndef GL_KHR_parallel_shader_compile
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+extern PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glext_glMaxShaderCompilerThreadsKHR;
+#define glMaxShaderCompilerThreadsKHR glext_glMaxShaderCompilerThreadsKHR
+#endif
+
+#ifndef GL_VERSION_4_3
+#define GL_COMPUTE_SHADER                 0x91B9
+#define GL_TEXTURE_FETCH_BARRIER_BIT      0x00000008
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#define GL_TEXTURE_UPDATE_BARRIER_BIT     0x00000100
+#define GL_FRAMEBUFFER_BARRIER_BIT        0x00000400
+#define GL_COMMAND_BARRIER_BIT            0x00000040
+#define GL_SHADER_STORAGE_BARRIER_BIT     0x00002000
+#define GL_ALL_BARRIER_BITS               0xFFFFFFFF
+#define GL_SHADER_STORAGE_BUFFER          0x90D2
+
+typedef void (APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z);
+typedef void (APIENTRYP PFNGLBINDIMAGETEXTUREPROC)(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+typedef void (APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+
+extern PFNGLDISPATCHCOMPUTEPROC glext_glDispatchCompute;
+extern PFNGLBINDIMAGETEXTUREPROC glext_glBindImageTexture;
+extern PFNGLMEMORYBARRIERPROC glext_glMemoryBarrier;
+#define glDispatchCompute glext_glDispatchCompute
+#define glBindImageTexture glext_glBindImageTexture
+#define glMemoryBarrier glext_glMemoryBarrier
+#endif
+
+namespace GLExtensions {
+    // Returns false only if the current context could not be queried
+    bool load(GLADloadproc loader);
+
+    // Program binary retrieval (GL 4.1 or ARB_get_program_binary) with at
+    // least one binary format the driver can reload
+    bool hasProgramBinaries();
+
+    // Background shader compilation on driver threads
+    // (KHR/ARB_parallel_shader_compile); load() already asks for as many
+    // threads as the driver allows
+    bool hasParallelShaderCompile();
+
+    // Compute shaders and image load/store (GL 4.3)
+    bool hasComputeShaders();
+
+    // Draws whose parameters come from a buffer (GL 4.0)
+    bool hasIndirectDraws();
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "GpuProfiler.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+GpuProfiler::Scope::Scope(GpuProfiler* profiler, const char* name)
+    : zone(name), profiler(profiler) {
+    if (profiler) profiler->begin(name);
+}
+
+GpuProfiler::Scope::~Scope() {
+    if (profiler) profiler->end();
+}
+
+GpuProfiler::GpuProfiler(int ringFrames, int historyFrames)
+    : ringFrames(std::max(ringFrames, 1)), historyFrames(std::max(historyFrames, 1)),
+    recording(false), timing(false), skippedFrames(0) {
+}
+
+GpuProfiler::~GpuProfiler() {
+    for (const Frame& frame : inFlight) {
+        for (const Interval& interval : frame.intervals) {
+            freeQueries.push_back(interval.query);
+        }
+    }
+    for (const Interval& interval : current.intervals) {
+        freeQueries.push_back(interval.query);
+    }
+    if (!freeQueries.empty()) {
+        glDeleteQueries((GLsizei)freeQueries.size(), freeQueries.data());
+    }
+}
+
+GLuint GpuProfiler::takeQuery() {
+    if (freeQueries.empty()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        return query;
+    }
+    GLuint query = freeQueries.back();
+    freeQueries.pop_back();
+    return query;
+}
+
+int GpuProfiler::findPass(const char* name) {
+    for (size_t i = 0; i < passes.size(); i++) {
+        if (passes[i].name == name) return (int)i;
+    }
+    Pass pass;
+    pass.name = name;
+    passes.push_back(pass);
+    return (int)passes.size() - 1;
+}
+
+void GpuProfiler::beginFrame() {
+    collect();
+    // A full ring means the GPU is that many frames behind; skip this one
+    // rather than wait for a query to free up
+    recording = (int)inFlight.size() < ringFrames;
+    if (!recording) skippedFrames++;
+}
+
+void GpuProfiler::endFrame() {
+    if (timing) end();
+    if (recording && !current.intervals.empty()) {
+        inFlight.push_back(current);
+    }
+    current.intervals.clear();
+    recording = false;
+}
+
+void GpuProfiler::begin(const char* name) {
+    if (!recording) return;
+    if (timing) end();
+    Interval interval;
+    interval.pass = findPass(name);
+    interval.query = takeQuery();
+    glBeginQuery(GL_TIME_ELAPSED, interval.query);
+    current.intervals.push_back(interval);
+    timing = true;
+}
+
+void GpuProfiler::end() {
+    if (!timing) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    timing = false;
+}
+
+void GpuProfiler::collect() {
+    std::vector<double> frameMs;
+    // Queries complete in order, so a frame is done once its last one is
+    while (!inFlight.empty()) {
+        Frame& frame = inFlight.front();
+        GLint available = 0;
+        glGetQueryObjectiv(frame.intervals.back().query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+
+        frameMs.assign(passes.size(), -1.0);
+        for (const Interval& interval : frame.intervals) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(interval.query, GL_QUERY_RESULT, &elapsed);
+            double& total = frameMs[interval.pass];
+            total = std::max(total, 0.0) + (double)elapsed * 1e-6;
+            freeQueries.push_back(interval.query);
+        }
+        for (size_t i = 0; i < passes.size(); i++) {
+            if (frameMs[i] < 0.0) continue;
+            std::deque<double>& history = passes[i].history;
+            history.push_back(frameMs[i]);
+            if ((int)history.size() > historyFrames) history.pop_front();
+        }
+        inFlight.pop_front();
+    }
+}
+
+std::vector<GpuProfiler::PassStats> GpuProfiler::getStats() const {
+    std::vector<PassStats> stats;
+    std::vector<double> sorted;
+    for (const Pass& pass : passes) {
+        PassStats entry;
+        entry.name = pass.name;
+        entry.samples = (int)pass.history.size();
+        if (entry.samples > 0) {
+            sorted.assign(pass.history.begin(), pass.history.end());
+            std::sort(sorted.begin(), sorted.end());
+            double sum = 0.0;
+            for (double ms : sorted) sum += ms;
+            entry.minMs = sorted.front();
+            entry.meanMs = sum / sorted.size();
+            // Nearest rank
+            size_t rank = (size_t)std::ceil(0.99 * sorted.size());
+            entry.p99Ms = sorted[std::max(rank, (size_t)1) - 1];
+        }
+        stats.push_back(entry);
+    }
+    return stats;
+}
+
+void GpuProfiler::print(std::ostream& out) const {
+    std::vector<PassStats> stats = getStats();
+    size_t width = 4;
+    for (const PassStats& entry : stats) {
+        width = std::max(width, entry.name.size());
+    }
+
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    out << std::left << std::setw((int)width) << "Pass" << std::right
+        << std::setw(10) << "min ms" << std::setw(10) << "mean ms" << std::setw(10) << "p99 ms"
+        << std::setw(9) << "frames" << std::endl;
+    double total = 0.0;
+    for (const PassStats& entry : stats) {
+        out << std::left << std::setw((int)width) << entry.name << std::right
+            << std::setw(10) << entry.minMs << std::setw(10) << entry.meanMs << std::setw(10) << entry.p99Ms
+            << std::setw(9) << entry.samples << std::endl;
+        total += entry.meanMs;
+    }
+    out << "Total of means: " << total << " ms";
+    if (skippedFrames > 0) out << " (" << skippedFrames << " frames skipped)";
+    out << std::endl;
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void GpuProfiler::writeCsvHeader(std::ostream& out) {
+    out << "time,pass,samples,min_ms,mean_ms,p99_ms" << std::endl;
+}
+
+void GpuProfiler::writeCsv(std::ostream& out, double time) const {
+    for (const PassStats& entry : getStats()) {
+        out << time << "," << entry.name << "," << entry.samples << ","
+            << entry.minMs << "," << entry.meanMs << "," << entry.p99Ms << std::endl;
+    }
+}
\ No newline at end of file
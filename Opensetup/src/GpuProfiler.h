@@ -0,0 +1,94 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Trace.h"
+
+// GPU time of named passes, from GL_TIME_ELAPSED queries. Queries of a frame
+// are read back frames later, once the last of them is available, and a
+// frame that would need more than ringFrames in flight is skipped rather
+// than waited on, so profiling never stalls the pipeline. A pass timed
+// several times in a frame (e.g. once per solver call) is summed into one
+// sample for that frame; the statistics cover the last historyFrames
+// samples of each pass.
+//
+// Time-elapsed queries cannot nest, so passes must not overlap. Some
+// drivers (llvmpipe among them) report next to nothing for compute work.
+class GpuProfiler {
+public:
+    struct PassStats {
+        std::string name;
+        int samples = 0;
+        double minMs = 0.0;
+        double meanMs = 0.0;
+        double p99Ms = 0.0;
+    };
+
+    // Times a pass for as long as it is in scope; a null profiler does
+    // nothing. The pass is also a CPU trace zone (see Trace.h).
+    class Scope {
+    public:
+        Scope(GpuProfiler* profiler, const char* name);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        Trace::Zone zone;
+        GpuProfiler* profiler;
+    };
+
+    explicit GpuProfiler(int ringFrames = 4, int historyFrames = 240);
+    ~GpuProfiler();
+
+    // Bracket a frame; beginFrame() also collects finished frames
+    void beginFrame();
+    void endFrame();
+
+    void begin(const char* name);
+    void end();
+
+    // Adds the frames whose queries are available to the statistics
+    void collect();
+
+    // Passes in the order they were first timed
+    std::vector<PassStats> getStats() const;
+    int getSkippedFrames() const { return skippedFrames; }
+
+    // Table of min/mean/p99 per pass
+    void print(std::ostream& out) const;
+    // One "time,pass,samples,min_ms,mean_ms,p99_ms" row per pass
+    static void writeCsvHeader(std::ostream& out);
+    void writeCsv(std::ostream& out, double time) const;
+
+private:
+    struct Pass {
+        std::string name;
+        std::deque<double> history;     // ms per frame
+    };
+    struct Interval {
+        int pass;
+        GLuint query;
+    };
+    struct Frame {
+        std::vector<Interval> intervals;
+    };
+
+    int ringFrames;
+    int historyFrames;
+    std::vector<Pass> passes;
+    std::deque<Frame> inFlight;
+    Frame current;
+    bool recording;     // inside a frame that is being measured
+    bool timing;        // a query is open
+    int skippedFrames;
+    std::vector<GLuint> freeQueries;
+
+    int findPass(const char* name);
+    GLuint takeQuery();
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "GpuReduction.h"
+#include "ShaderSources.h"
+#include <algorithm>
+#include <cmath>
+
+float ReductionResult::rms() const {
+    return count > 0 ? std::sqrt(sumSquares / count) : 0.0f;
+}
+
+float ReductionResult::deviation() const {
+    if (count <= 0) return 0.0f;
+    float mean = sum / count;
+    return std::sqrt(std::max(sumSquares / count - mean * mean, 0.0f));
+}
+
+GpuReduction::GpuReduction()
+    : srcW(0), srcH(0) {
+}
+
+GpuReduction::~GpuReduction() {
+    deleteLevels();
+    for (Readback& readback : inFlight) {
+        glDeleteSync(readback.fence);
+        freeBuffers.push_back(readback.buffer);
+    }
+    if (!freeBuffers.empty()) glDeleteBuffers((GLsizei)freeBuffers.size(), freeBuffers.data());
+}
+
+void GpuReduction::init(int width, int height) {
+    if (!reduceShader) {
+        reduceShader = std::make_unique<Shader>(ShaderSources::vs_shader, ShaderSources::reduce_fs);
+        reduceShader->finish();
+        reduceShader->bindSamplers({ "source" });
+        quad.init();
+    }
+
+    deleteLevels();
+    srcW = width;
+    srcH = height;
+
+    int w = width, h = height;
+    do {
+        RenderTarget level;
+        level.create((w + 3) / 4, (h + 3) / 4, GL_RGBA32F, GL_RGBA, GL_FLOAT, GL_NEAREST);
+        levels.push_back(level);
+        w = level.width;
+        h = level.height;
+    } while (w > 1 || h > 1);
+}
+
+void GpuReduction::deleteLevels() {
+    for (RenderTarget& level : levels) {
+        level.destroy();
+    }
+    levels.clear();
+}
+
+void GpuReduction::reduce(GLuint source, Mode mode) {
+    reduceShader->use();
+    glActiveTexture(GL_TEXTURE0);
+
+    GLuint input = source;
+    int inputW = srcW, inputH = srcH;
+    for (size_t i = 0; i < levels.size(); i++) {
+        levels[i].bind();
+        reduceShader->setInt("mode", i == 0 ? (int)mode : 0);
+        reduceShader->setIVec2("sourceSize", inputW, inputH);
+        glBindTexture(GL_TEXTURE_2D, input);
+        quad.draw();
+
+        input = levels[i].texture;
+        inputW = levels[i].width;
+        inputH = levels[i].height;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GpuReduction::request(GLuint source, Mode mode) {
+    reduce(source, mode);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, levels.back().framebuffer);
+
+    // Buffers are recycled once read, so only a few ever exist
+    Readback readback;
+    if (freeBuffers.empty()) {
+        glGenBuffers(1, &readback.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, 4 * sizeof(float), NULL, GL_STREAM_READ);
+    }
+    else {
+        readback.buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    }
+    glReadPixels(0, 0, 1, 1, GL_RGBA, GL_FLOAT, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.count = srcW * srcH;
+    inFlight.push_back(readback);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+bool GpuReduction::poll(ReductionResult& result) {
+    return readOldest(result, 0);
+}
+
+bool GpuReduction::wait(ReductionResult& result) {
+    return readOldest(result, GL_TIMEOUT_IGNORED);
+}
+
+bool GpuReduction::readOldest(ReductionResult& result, GLuint64 timeout) {
+    if (inFlight.empty()) return false;
+
+    Readback readback = inFlight.front();
+    GLenum status = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        return false;
+    }
+    glDeleteSync(readback.fence);
+    inFlight.pop_front();
+
+    float values[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(values), GL_MAP_READ_BIT);
+    if (mapped) {
+        for (int i = 0; i < 4; i++) {
+            values[i] = ((const float*)mapped)[i];
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    result.maxValue = values[0];
+    result.sumSquares = values[1];
+    result.sum = values[2];
+    result.count = readback.count;
+
+    freeBuffers.push_back(readback.buffer);
+    return true;
+}
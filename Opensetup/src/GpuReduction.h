@@ -0,0 +1,65 @@
+#ifndef GPU_REDUCTION_H
+#define GPU_REDUCTION_H
+
+#include <glad/glad.h>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "Shader.h"
+#include "Quad.h"
+#include "RenderTarget.h"
+
+struct ReductionResult {
+    float maxValue;
+    float sumSquares;
+    float sum;
+    int count;      // number of source texels
+
+    float rms() const;
+    float deviation() const;    // RMS about the mean
+};
+
+// Reduces a field texture to (max, sum of squares, sum) through a chain of 4x4
+// reduction passes and reads the 1x1 result back through pixel buffer
+// objects, so the CPU can poll for it later without stalling the pipeline.
+// Results are returned in the order they were requested.
+class GpuReduction {
+public:
+    enum class Mode {
+        Scalar = 1,     // r of a single-channel field (max is of |r|)
+        Length = 2      // length(rg) of a vector field
+    };
+
+    GpuReduction();
+    ~GpuReduction();
+
+    void init(int width, int height);
+    // Runs the reduction passes only; the 1x1 result stays on the GPU
+    void reduce(GLuint source, Mode mode);
+    GLuint getResultTexture() const { return levels.back().texture; }
+    // Runs the reduction and queues an asynchronous readback of the result
+    void request(GLuint source, Mode mode);
+    bool poll(ReductionResult& result);
+    bool wait(ReductionResult& result);
+    int pending() const { return (int)inFlight.size(); }
+
+private:
+    struct Readback {
+        GLuint buffer;
+        GLsync fence;
+        int count;
+    };
+
+    int srcW, srcH;
+    std::vector<RenderTarget> levels;
+    std::deque<Readback> inFlight;
+    std::vector<GLuint> freeBuffers;
+
+    std::unique_ptr<Shader> reduceShader;
+    Quad quad;
+
+    void deleteLevels();
+    bool readOldest(ReductionResult& result, GLuint64 timeout);
+};
+
+#endif
@@ -0,0 +1,166 @@
+#include "HeadlessContext.h"
+#include "GLExtensions.h"
+#include <glad/glad.h>
+#include <iostream>
+#include <cstring>
+
+#ifdef _WIN32
+#include <GLFW/glfw3.h>
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#ifdef _WIN32
+
+HeadlessContext::HeadlessContext() : display(nullptr), context(nullptr) {
+}
+
+HeadlessContext::~HeadlessContext() {
+    if (context) {
+        glfwDestroyWindow((GLFWwindow*)context);
+        glfwTerminate();
+    }
+}
+
+bool HeadlessContext::initialize() {
+    if (!glfwInit()) {
+        std::cout << "Failed to initialize GLFW" << std::endl;
+        return false;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    GLFWwindow* window = glfwCreateWindow(1, 1, "headless", NULL, NULL);
+    if (!window) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        window = glfwCreateWindow(1, 1, "headless", NULL, NULL);
+    }
+    if (!window) {
+        std::cout << "Failed to create hidden GLFW window" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+    context = window;
+
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return false;
+    }
+    GLExtensions::load((GLADloadproc)glfwGetProcAddress);
+
+    std::cout << "Headless context: " << glGetString(GL_RENDERER)
+        << " (" << glGetString(GL_VERSION) << ")" << std::endl;
+    return true;
+}
+
+#else
+
+static bool hasExtension(const char* extensions, const char* name) {
+    if (!extensions) return false;
+    size_t len = strlen(name);
+    const char* p = extensions;
+    while ((p = strstr(p, name)) != nullptr) {
+        if ((p == extensions || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0')) {
+            return true;
+        }
+        p += len;
+    }
+    return false;
+}
+
+HeadlessContext::HeadlessContext() : display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT) {
+}
+
+HeadlessContext::~HeadlessContext() {
+    if (display != EGL_NO_DISPLAY) {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != EGL_NO_CONTEXT) {
+            eglDestroyContext(display, context);
+        }
+        eglTerminate(display);
+    }
+}
+
+bool HeadlessContext::initialize() {
+    // Prefer the Mesa surfaceless platform so no X11/Wayland server is needed
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (getPlatformDisplay && hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::cout << "Failed to initialize EGL display" << std::endl;
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cout << "EGL display does not support desktop OpenGL" << std::endl;
+        return false;
+    }
+
+    const char* displayExtensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (!hasExtension(displayExtensions, "EGL_KHR_surfaceless_context")) {
+        std::cout << "EGL_KHR_surfaceless_context is not supported" << std::endl;
+        return false;
+    }
+
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    if (!hasExtension(displayExtensions, "EGL_KHR_no_config_context")) {
+        const EGLint configAttribs[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_NONE
+        };
+        EGLint numConfigs = 0;
+        if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+            std::cout << "Failed to choose an EGL config" << std::endl;
+            return false;
+        }
+    }
+
+    // 4.3 enables the compute-shader path; 3.3 is enough for everything else
+    const EGLint versions[2][2] = { { 4, 3 }, { 3, 3 } };
+    for (const EGLint* version : versions) {
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, version[0],
+            EGL_CONTEXT_MINOR_VERSION, version[1],
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+        if (context != EGL_NO_CONTEXT) break;
+    }
+    if (context == EGL_NO_CONTEXT) {
+        std::cout << "Failed to create EGL context" << std::endl;
+        return false;
+    }
+
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cout << "Failed to make EGL context current" << std::endl;
+        return false;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return false;
+    }
+    GLExtensions::load((GLADloadproc)eglGetProcAddress);
+
+    std::cout << "Headless context: " << glGetString(GL_RENDERER)
+        << " (" << glGetString(GL_VERSION) << ")" << std::endl;
+    return true;
+}
+
+#endif
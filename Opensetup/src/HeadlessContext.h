@@ -0,0 +1,19 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+// Offscreen OpenGL context for running FluidSimulation without a window.
+// On Linux this is an EGL surfaceless context (works on Mesa llvmpipe with no
+// display server); on Windows it falls back to a hidden GLFW window.
+class HeadlessContext {
+public:
+    HeadlessContext();
+    ~HeadlessContext();
+
+    bool initialize();
+
+private:
+    void* display;
+    void* context;
+};
+
+#endif
@@ -1,34 +1,54 @@
 #include "InputHandler.h"
+#include "Trace.h"
 
 InputHandler* InputHandler::instance = nullptr;
 
 InputHandler::InputHandler()
-    : mouseX(0.0), mouseY(0.0), prevMouseX(0.0), prevMouseY(0.0), mouseDown(false) {
+    : mouseX(0.0), mouseY(0.0), mouseDown(false), eventHead(0), eventTail(0), droppedEvents(0) {
     instance = this;
 }
 
-void InputHandler::update() {
-    if (mouseDown) {
-        prevMouseX = mouseX;
-        prevMouseY = mouseY;
-    }
-}
-
 void InputHandler::setWindow(GLFWwindow* window) {
     glfwSetMouseButtonCallback(window, mouseButtonCallback);
     glfwSetCursorPosCallback(window, cursorPositionCallback);
 }
 
+void InputHandler::pushEvent(CursorEvent::Type type, double x, double y) {
+    // Marks the arrival on the timeline, to measure the latency to the step
+    // that applies it
+    TRACE_INSTANT("cursor event");
+    unsigned head = eventHead.load(std::memory_order_relaxed);
+    if (head - eventTail.load(std::memory_order_acquire) == eventCapacity) {
+        droppedEvents++;
+        return;
+    }
+    CursorEvent& event = events[head % eventCapacity];
+    event.type = type;
+    event.x = x;
+    event.y = y;
+    event.time = glfwGetTime();
+    eventHead.store(head + 1, std::memory_order_release);
+}
+
+void InputHandler::drainEvents(std::vector<CursorEvent>& out) {
+    unsigned tail = eventTail.load(std::memory_order_relaxed);
+    unsigned head = eventHead.load(std::memory_order_acquire);
+    for (; tail != head; tail++) {
+        out.push_back(events[tail % eventCapacity]);
+    }
+    eventTail.store(tail, std::memory_order_release);
+}
+
 void InputHandler::mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
     if (instance && button == GLFW_MOUSE_BUTTON_LEFT) {
         if (action == GLFW_PRESS) {
             instance->mouseDown = true;
-            glfwGetCursorPos(window, &instance->prevMouseX, &instance->prevMouseY);
-            instance->mouseX = instance->prevMouseX;
-            instance->mouseY = instance->prevMouseY;
+            glfwGetCursorPos(window, &instance->mouseX, &instance->mouseY);
+            instance->pushEvent(CursorEvent::Press, instance->mouseX, instance->mouseY);
         }
         else if (action == GLFW_RELEASE) {
             instance->mouseDown = false;
+            instance->pushEvent(CursorEvent::Release, instance->mouseX, instance->mouseY);
         }
     }
 }
@@ -37,5 +57,8 @@ void InputHandler::cursorPositionCallback(GLFWwindow* window, double xpos, doubl
     if (instance) {
         instance->mouseX = xpos;
         instance->mouseY = ypos;
+        if (instance->mouseDown) {
+            instance->pushEvent(CursorEvent::Move, xpos, ypos);
+        }
     }
 }
\ No newline at end of file
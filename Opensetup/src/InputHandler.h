@@ -2,30 +2,51 @@
 #define INPUT_HANDLER_H
 
 #include <GLFW/glfw3.h>
+#include <atomic>
+#include <vector>
+
+// One cursor sample in window pixels, stamped with glfwGetTime() when the
+// callback ran. Press and release delimit a stroke.
+struct CursorEvent {
+    enum Type { Press, Move, Release };
+    Type type;
+    double x, y;
+    double time;
+};
 
 class InputHandler {
 public:
     InputHandler();
 
-    void update();
     void setWindow(GLFWwindow* window);
 
     bool isMouseDown() const { return mouseDown; }
     double getMouseX() const { return mouseX; }
     double getMouseY() const { return mouseY; }
-    double getPrevMouseX() const { return prevMouseX; }
-    double getPrevMouseY() const { return prevMouseY; }
-    double getMouseDeltaX() const { return mouseX - prevMouseX; }
-    double getMouseDeltaY() const { return mouseY - prevMouseY; }
+
+    // Appends every event recorded since the last call, oldest first. The
+    // callbacks push into a single-producer single-consumer ring, so events
+    // may be drained from another thread than the one polling GLFW.
+    void drainEvents(std::vector<CursorEvent>& out);
+    // Events lost because the ring was full
+    unsigned getDroppedEvents() const { return droppedEvents; }
 
     static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
     static void cursorPositionCallback(GLFWwindow* window, double xpos, double ypos);
 
 private:
     double mouseX, mouseY;
-    double prevMouseX, prevMouseY;
     bool mouseDown;
 
+    // Ample for a frame of high-rate mouse input
+    static const unsigned eventCapacity = 1024;
+    CursorEvent events[eventCapacity];
+    std::atomic<unsigned> eventHead;    // next slot to write, producer only
+    std::atomic<unsigned> eventTail;    // next slot to read, consumer only
+    unsigned droppedEvents;
+
+    void pushEvent(CursorEvent::Type type, double x, double y);
+
     static InputHandler* instance;
 };
 
@@ -24,3 +24,7 @@ void Quad::draw() const {
     glBindVertexArray(vao);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 }
+
+void Quad::bind() const {
+    glBindVertexArray(vao);
+}
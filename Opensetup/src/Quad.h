@@ -6,6 +6,7 @@ public:
     Quad() = default;
     void init();     // <-- new
     void draw() const;
+    void bind() const;  // for draws other than the plain quad
 
 private:
     GLuint vao = 0;
@@ -0,0 +1,84 @@
+#include "RenderTarget.h"
+#include <iostream>
+
+static bool checkFramebuffer(const char* what) {
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << what << " framebuffer incomplete: 0x" << std::hex << status << std::dec << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool RenderTarget::create(int w, int h, GLenum internalFormat, GLenum format, GLenum type, GLint filter) {
+    width = w;
+    height = h;
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    bool complete = checkFramebuffer("Render target");
+    // Textures start out undefined; clear so every field begins at zero
+    glViewport(0, 0, width, height);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+void RenderTarget::destroy() {
+    if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+    if (texture) glDeleteTextures(1, &texture);
+    framebuffer = 0;
+    texture = 0;
+}
+
+void RenderTarget::bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+}
+
+bool DoubleRenderTarget::create(int width, int height, GLenum internalFormat, GLenum format, GLenum type) {
+    current = 0;
+    bool complete = targets[0].create(width, height, internalFormat, format, type);
+    return targets[1].create(width, height, internalFormat, format, type) && complete;
+}
+
+void DoubleRenderTarget::destroy() {
+    targets[0].destroy();
+    targets[1].destroy();
+}
+
+bool RenderTargetPair::create(const RenderTarget& first, const RenderTarget& second) {
+    static const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    textures[0] = first.texture;
+    textures[1] = second.texture;
+    width = first.width;
+    height = first.height;
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, first.texture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, second.texture, 0);
+    glDrawBuffers(2, drawBuffers);
+    bool complete = checkFramebuffer("Render target pair");
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+void RenderTargetPair::destroy() {
+    if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+    framebuffer = 0;
+}
+
+void RenderTargetPair::bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <glad/glad.h>
+
+// A texture together with a framebuffer object that renders into it. The
+// attachment is made and checked for completeness once, at creation, so a
+// pass only has to bind it. RenderTarget is a plain handle: copies refer to
+// the same GL objects and destroy() releases them, which lets owners swap
+// targets around as freely as texture names.
+struct RenderTarget {
+    GLuint texture = 0;
+    GLuint framebuffer = 0;
+    int width = 0;
+    int height = 0;
+
+    bool create(int width, int height, GLenum internalFormat, GLenum format, GLenum type, GLint filter = GL_LINEAR);
+    void destroy();
+    void bind() const;      // binds the framebuffer and sets the viewport
+};
+
+// Ping-pong pair for passes that read a field and write its next value
+struct DoubleRenderTarget {
+    RenderTarget targets[2];
+    int current = 0;
+
+    bool create(int width, int height, GLenum internalFormat, GLenum format, GLenum type);
+    void destroy();
+    const RenderTarget& read() const { return targets[current]; }
+    const RenderTarget& write() const { return targets[1 - current]; }
+    void swap() { current = 1 - current; }
+};
+
+// Framebuffer drawing into two targets at once (multiple render targets)
+struct RenderTargetPair {
+    GLuint framebuffer = 0;
+    GLuint textures[2] = { 0, 0 };
+    int width = 0;
+    int height = 0;
+
+    bool create(const RenderTarget& first, const RenderTarget& second);
+    void destroy();
+    void bind() const;
+};
+
+#endif
\ No newline at end of file
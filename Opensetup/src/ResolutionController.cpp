@@ -0,0 +1,110 @@
+#include "ResolutionController.h"
+#include <algorithm>
+#include <cmath>
+
+ResolutionController::ResolutionController()
+    : pendingStart(0), sampleMs(0.0), sampleSteps(0), settleSteps(0), averageStepMs(0.0) {
+}
+
+ResolutionController::~ResolutionController() {
+    for (const Measurement& measurement : inFlight) {
+        freeQueries.push_back(measurement.start);
+        freeQueries.push_back(measurement.end);
+    }
+    if (pendingStart) freeQueries.push_back(pendingStart);
+    if (!freeQueries.empty()) {
+        glDeleteQueries((GLsizei)freeQueries.size(), freeQueries.data());
+    }
+}
+
+GLuint ResolutionController::takeQuery() {
+    if (freeQueries.empty()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        return query;
+    }
+    GLuint query = freeQueries.back();
+    freeQueries.pop_back();
+    return query;
+}
+
+void ResolutionController::begin() {
+    if (!pendingStart) pendingStart = takeQuery();
+    glQueryCounter(pendingStart, GL_TIMESTAMP);
+}
+
+void ResolutionController::end(int steps) {
+    if (!pendingStart) return;
+    if (steps <= 0) {
+        // Nothing to measure; the start query is reused next frame
+        return;
+    }
+    Measurement measurement;
+    measurement.start = pendingStart;
+    measurement.end = takeQuery();
+    measurement.steps = steps;
+    glQueryCounter(measurement.end, GL_TIMESTAMP);
+    inFlight.push_back(measurement);
+    pendingStart = 0;
+}
+
+int ResolutionController::roundSize(double size) const {
+    int step = std::max(settings.sizeStep, 1);
+    int rounded = (int)std::lround(size / step) * step;
+    return std::max(rounded, step);
+}
+
+bool ResolutionController::update(int currentWidth, int currentHeight, int& width, int& height) {
+    // Results complete in order, so stop at the first that is not ready
+    while (!inFlight.empty()) {
+        const Measurement& measurement = inFlight.front();
+        GLint available = 0;
+        glGetQueryObjectiv(measurement.end, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(measurement.start, GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(measurement.end, GL_QUERY_RESULT, &end);
+        if (settleSteps > 0) {
+            // Includes the resize itself and first-use allocations
+            settleSteps -= measurement.steps;
+        }
+        else {
+            sampleMs += (double)(end - start) * 1e-6;
+            sampleSteps += measurement.steps;
+        }
+        freeQueries.push_back(measurement.start);
+        freeQueries.push_back(measurement.end);
+        inFlight.pop_front();
+    }
+
+    if (sampleSteps < settings.sampleSteps) return false;
+    averageStepMs = sampleMs / sampleSteps;
+    sampleMs = 0.0;
+    sampleSteps = 0;
+
+    // Cost scales with the texel count, so the size scales with its root.
+    // Either way the new size aims at the middle of the band between the
+    // growth threshold and the budget.
+    double target = settings.budgetMs * (1.0 + settings.headroom) * 0.5;
+    double scale = 1.0;
+    if (averageStepMs > settings.budgetMs || averageStepMs < settings.budgetMs * settings.headroom) {
+        scale = std::sqrt(target / std::max(averageStepMs, 1e-3));
+    }
+    // Move at most a factor of two per decision; the next window corrects
+    scale = std::min(std::max(scale, 0.5), 2.0);
+
+    int larger = std::max(currentWidth, currentHeight);
+    int size = roundSize(larger * scale);
+    size = std::min(std::max(size, settings.minSize), settings.maxSize);
+    if (size == larger) return false;
+
+    // Keep the aspect ratio
+    double ratio = (double)size / larger;
+    width = std::max(roundSize(currentWidth * ratio), 1);
+    height = std::max(roundSize(currentHeight * ratio), 1);
+    if (width == currentWidth && height == currentHeight) return false;
+
+    settleSteps = settings.settleSteps;
+    return true;
+}
\ No newline at end of file
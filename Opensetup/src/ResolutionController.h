@@ -0,0 +1,63 @@
+#ifndef RESOLUTION_CONTROLLER_H
+#define RESOLUTION_CONTROLLER_H
+
+#include <glad/glad.h>
+#include <deque>
+#include <vector>
+
+struct ResolutionSettings {
+    double budgetMs = 8.0;      // target GPU time per step
+    double headroom = 0.75;     // grow once the step time drops under budget * headroom
+    int minSize = 64;           // bounds of the larger grid dimension
+    int maxSize = 1024;
+    int sizeStep = 16;          // grid sizes are multiples of this
+    int sampleSteps = 20;       // steps averaged before deciding
+    int settleSteps = 10;       // steps ignored after a resize
+};
+
+// Picks the simulation grid size that fits a per-step time budget. The GPU
+// time of each frame's steps is measured with GL_TIMESTAMP queries that are
+// read back frames later, so measuring never stalls the pipeline. Step cost
+// is taken to scale with the texel count. A missed budget shrinks the grid
+// and a step time under budget * headroom grows it, in both cases to the size
+// predicted to land between the two, so it does not oscillate around either.
+class ResolutionController {
+public:
+    ResolutionController();
+    ~ResolutionController();
+
+    void setSettings(const ResolutionSettings& settings) { this->settings = settings; }
+    const ResolutionSettings& getSettings() const { return settings; }
+
+    // Bracket the steps run in a frame
+    void begin();
+    void end(int steps);
+
+    // Collects finished measurements; returns true with the new size once
+    // enough of them call for one. The caller resizes the simulation.
+    bool update(int currentWidth, int currentHeight, int& width, int& height);
+
+    // Mean GPU time per step over the last decision window, 0 before one
+    double getAverageStepMs() const { return averageStepMs; }
+
+private:
+    struct Measurement {
+        GLuint start, end;
+        int steps;
+    };
+
+    ResolutionSettings settings;
+    std::deque<Measurement> inFlight;
+    std::vector<GLuint> freeQueries;
+    GLuint pendingStart;
+
+    double sampleMs;
+    int sampleSteps;
+    int settleSteps;
+    double averageStepMs;
+
+    GLuint takeQuery();
+    int roundSize(double size) const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "ShaderCache.h"
+#include "GLExtensions.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+    // Bump when the file layout changes
+    const char magic[8] = { 'F', 'L', 'U', 'I', 'D', 'P', 'B', '1' };
+
+    struct FileHeader {
+        char magic[8];
+        uint64_t key;
+        uint32_t format;
+        uint32_t length;
+    };
+
+    std::string cacheDirectory;
+    ShaderCache::Stats stats;
+
+    uint64_t hashBytes(uint64_t hash, const char* data, size_t length) {
+        // FNV-1a
+        for (size_t i = 0; i < length; i++) {
+            hash ^= (unsigned char)data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    uint64_t hashString(uint64_t hash, const char* text) {
+        // The terminator separates consecutive strings
+        return hashBytes(hash, text ? text : "", text ? strlen(text) + 1 : 1);
+    }
+
+    uint64_t cacheKey(const char* const* sources, int count) {
+        uint64_t hash = 14695981039346656037ull;
+        hash = hashString(hash, (const char*)glGetString(GL_VENDOR));
+        hash = hashString(hash, (const char*)glGetString(GL_RENDERER));
+        hash = hashString(hash, (const char*)glGetString(GL_VERSION));
+        hash = hashBytes(hash, (const char*)&count, sizeof(count));
+        for (int i = 0; i < count; i++) {
+            hash = hashString(hash, sources[i]);
+        }
+        return hash;
+    }
+
+    std::string entryPath(uint64_t key) {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return cacheDirectory + "/" + name;
+    }
+
+    void makeDirectory(const std::string& path) {
+#ifdef _WIN32
+        _mkdir(path.c_str());
+#else
+        mkdir(path.c_str(), 0755);
+#endif
+    }
+}
+
+namespace ShaderCache {
+
+void setDirectory(const std::string& directory) {
+    cacheDirectory = directory;
+}
+
+bool isEnabled() {
+    return !cacheDirectory.empty() && GLExtensions::hasProgramBinaries();
+}
+
+GLuint load(const char* const* sources, int count) {
+    if (!isEnabled()) return 0;
+
+    uint64_t key = cacheKey(sources, count);
+    std::string path = entryPath(key);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return 0;
+
+    FileHeader header;
+    std::vector<char> binary;
+    if (file.read((char*)&header, sizeof(header)) &&
+        memcmp(header.magic, magic, sizeof(magic)) == 0 && header.key == key && header.length > 0) {
+        binary.resize(header.length);
+        if (!file.read(binary.data(), binary.size())) binary.clear();
+    }
+    file.close();
+
+    GLuint program = 0;
+    GLint success = GL_FALSE;
+    if (!binary.empty()) {
+        program = glCreateProgram();
+        glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+    }
+    if (!success) {
+        // Truncated, foreign or no longer accepted by the driver
+        if (program) glDeleteProgram(program);
+        std::remove(path.c_str());
+        stats.rejected++;
+        return 0;
+    }
+
+    stats.loaded++;
+    return program;
+}
+
+void store(const char* const* sources, int count, GLuint program) {
+    stats.compiled++;
+    if (!isEnabled()) return;
+
+    GLint success = GL_FALSE;
+    GLint length = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (!success || length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0) return;
+
+    FileHeader header;
+    memcpy(header.magic, magic, sizeof(magic));
+    header.key = cacheKey(sources, count);
+    header.format = format;
+    header.length = (uint32_t)written;
+
+    // Concurrent workers may store the same entry, so each writes its own
+    // temporary file and renames it into place
+    makeDirectory(cacheDirectory);
+    std::string path = entryPath(header.key);
+    std::ostringstream temporary;
+    temporary << path << "." << std::hex << std::chrono::steady_clock::now().time_since_epoch().count() << ".tmp";
+    {
+        std::ofstream file(temporary.str(), std::ios::binary);
+        if (!file) {
+            std::cout << "Could not write shader cache entry " << temporary.str() << std::endl;
+            return;
+        }
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), written);
+    }
+    if (std::rename(temporary.str().c_str(), path.c_str()) != 0) {
+        // Another worker got there first (rename does not replace on Windows)
+        std::remove(temporary.str().c_str());
+    }
+}
+
+const Stats& getStats() {
+    return stats;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <glad/glad.h>
+#include <string>
+
+// On-disk cache of linked program binaries, so later launches (and every
+// ensemble worker after the first) skip compiling and linking. Entries are
+// keyed by a hash of the shader sources and the GL vendor, renderer and
+// version strings: an edited shader or a driver update simply misses, and
+// a binary the driver rejects is deleted and rebuilt from source.
+namespace ShaderCache {
+    struct Stats {
+        int loaded = 0;     // programs created from a cached binary
+        int compiled = 0;   // programs built from source
+        int rejected = 0;   // cached binaries the driver refused
+    };
+
+    // An empty directory disables the cache, which is the default. It is
+    // created on the first store.
+    void setDirectory(const std::string& directory);
+    // A directory is set and the current context can reload binaries
+    bool isEnabled();
+
+    // Returns a linked program from the cache, or 0 on a miss
+    GLuint load(const char* const* sources, int count);
+    // Saves the binary of a program linked from the given sources
+    void store(const char* const* sources, int count, GLuint program);
+
+    const Stats& getStats();
+}
+
+#endif
\ No newline at end of file
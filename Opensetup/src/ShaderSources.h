@@ -2,8 +2,13 @@
 #define SHADER_SOURCES_H
 
 namespace ShaderSources {
+    // Field passes read the per-step FrameConstants block and the pressure
+    // solver passes the LevelConstants block of the grid level they work on
+    // (std140, mirrored in FluidSimulation.cpp). Each sampler keeps the
+    // texture unit given by its declaration order.
+
     // Vertex shader for fullscreen quad
-    const char* vs_shader = R"(
+    const char* const vs_shader = R"(
 #version 330 core
 layout(location = 0) in vec2 aPos;
 layout(location = 1) in vec2 aUV;
@@ -14,43 +19,56 @@ void main() {
 }
 )";
 
-    // Fragment shader for displaying textures
-    const char* display_fs = R"(
+    // Fragment shader for displaying textures, blended from the previous
+    // state by the render interpolation factor
+    const char* const display_fs = R"(
 #version 330 core
 out vec4 FragColor;
 in vec2 uv;
 uniform sampler2D tex;
+uniform sampler2D previous;
+uniform float blend;
 void main() {
-    vec3 color = texture(tex, uv).rgb;
+    vec3 color = mix(texture(previous, uv).rgb, texture(tex, uv).rgb, blend);
     FragColor = vec4(color, 1.0);
 }
 )";
 
-    // Advection shader
-    const char* advect_fs = R"(
+    // Advection shader. The field may have its own resolution: velocity is
+    // sampled at the same normalised coordinates
+    const char* const advect_fs = R"(
 #version 330 core
 out vec4 FragColor;
 in vec2 uv;
 uniform sampler2D field;
 uniform sampler2D velocity;
-uniform float dt;
-uniform vec2 texelSize;
+layout(std140) uniform FrameConstants {
+    vec2 texelSize;
+    float dt;
+    float advectionDt;
+    float confinementStrength;
+};
 
 void main() {
     vec2 vel = texture(velocity, uv).xy;
-    vec2 prevUV = uv - dt * vel * texelSize;
+    vec2 prevUV = uv - advectionDt * vel;
     vec4 result = texture(field, prevUV);
     FragColor = result;
 }
 )";
 
     // Divergence computation shader
-    const char* divergence_fs = R"(
+    const char* const divergence_fs = R"(
 #version 330 core
 out vec4 FragColor;
 in vec2 uv;
 uniform sampler2D velocity;
-uniform vec2 texelSize;
+layout(std140) uniform FrameConstants {
+    vec2 texelSize;
+    float dt;
+    float advectionDt;
+    float confinementStrength;
+};
 
 void main() {
     vec2 left = texture(velocity, uv - vec2(texelSize.x, 0.0)).xy;
@@ -64,15 +82,16 @@ void main() {
 )";
 
     // Pressure solve (Jacobi iteration)
-    const char* pressure_fs = R"(
+    const char* const pressure_fs = R"(
 #version 330 core
 out vec4 FragColor;
 in vec2 uv;
 uniform sampler2D pressure;
 uniform sampler2D divergence;
-uniform vec2 texelSize;
-uniform float alpha;
-uniform float beta;
+layout(std140) uniform LevelConstants {
+    vec2 texelSize;
+    float h2;
+};
 
 void main() {
     float left = texture(pressure, uv - vec2(texelSize.x, 0.0)).r;
@@ -81,18 +100,23 @@ void main() {
     float top = texture(pressure, uv + vec2(0.0, texelSize.y)).r;
     float div = texture(divergence, uv).r;
     
-    float result = (left + right + bottom + top + alpha * div) * beta;
+    float result = (left + right + bottom + top - h2 * div) * 0.25;
     FragColor = vec4(result, 0.0, 0.0, 1.0);
 }
 )";
 
     // Vorticity computation shader
-    const char* vorticity_fs = R"(
+    const char* const vorticity_fs = R"(
 #version 330 core
 out vec4 FragColor;
 in vec2 uv;
 uniform sampler2D velocity;
-uniform vec2 texelSize;
+layout(std140) uniform FrameConstants {
+    vec2 texelSize;
+    float dt;
+    float advectionDt;
+    float confinementStrength;
+};
 
 void main() {
     vec2 left = texture(velocity, uv - vec2(texelSize.x, 0.0)).xy;
@@ -106,13 +130,18 @@ void main() {
 )";
 
     // Subtract pressure gradient
-    const char* gradient_fs = R"(
+    const char* const gradient_fs = R"(
 #version 330 core
 out vec4 FragColor;
 in vec2 uv;
 uniform sampler2D velocity;
 uniform sampler2D pressure;
-uniform vec2 texelSize;
+layout(std140) uniform FrameConstants {
+    vec2 texelSize;
+    float dt;
+    float advectionDt;
+    float confinementStrength;
+};
 
 void main() {
     float left = texture(pressure, uv - vec2(texelSize.x, 0.0)).r;
@@ -129,15 +158,18 @@ void main() {
 )";
 
     // Vorticity confinement shader
-    const char* confinement_fs = R"(
+    const char* const confinement_fs = R"(
 #version 330 core
 out vec4 FragColor;
 in vec2 uv;
 uniform sampler2D velocity;
 uniform sampler2D vorticity;
-uniform vec2 texelSize;
-uniform float dt;
-uniform float strength;
+layout(std140) uniform FrameConstants {
+    vec2 texelSize;
+    float dt;
+    float advectionDt;
+    float confinementStrength;
+};
 
 void main() {
     vec2 vel = texture(velocity, uv).xy;
@@ -152,29 +184,510 @@ void main() {
     float len = length(gradient) + 1e-5;
     gradient = gradient / len;
     
-    vec2 force = vec2(gradient.y, -gradient.x) * center * strength;
+    vec2 force = vec2(gradient.y, -gradient.x) * center * confinementStrength;
     vel += force * dt;
     
     FragColor = vec4(vel, 0.0, 1.0);
 }
 )";
 
-    // Splat shader for adding forces/dye
-    const char* splat_fs = R"(
+    // Footprint quad of one queued splat (drawn instanced, one instance per
+    // entry of the Splats block). It covers the square where the gaussian is
+    // above 1e-6 of its peak, so a splat costs its footprint, not the grid.
+    const char* const splat_vs = R"(
+#version 330 core
+#define MAX_SPLATS 256
+layout(location = 0) in vec2 aPos;
+flat out int splatIndex;
+
+struct Splat {
+    vec4 pointRadius;   // point in texels, radius, strength
+    vec4 color;
+};
+layout(std140) uniform Splats {
+    Splat splats[MAX_SPLATS];
+};
+// Of the target field, which may differ from the velocity grid (dye)
+uniform vec2 targetTexelSize;
+
+void main() {
+    vec4 pointRadius = splats[gl_InstanceID].pointRadius;
+    // exp(-d^2 / radius) < 1e-6 for d^2 > radius * ln(1e6)
+    float extent = sqrt(pointRadius.z * 13.8155) + 1.0;
+    vec2 corner = pointRadius.xy + aPos * extent;
+    gl_Position = vec4(corner * targetTexelSize * 2.0 - 1.0, 0.0, 1.0);
+    splatIndex = gl_InstanceID;
+}
+)";
+
+    // Gaussian impulse of one splat, added to the field by additive blending
+    const char* const splat_fs = R"(
+#version 330 core
+#define MAX_SPLATS 256
+out vec4 FragColor;
+flat in int splatIndex;
+
+struct Splat {
+    vec4 pointRadius;   // point in texels, radius, strength
+    vec4 color;
+};
+layout(std140) uniform Splats {
+    Splat splats[MAX_SPLATS];
+};
+
+void main() {
+    vec4 pointRadius = splats[splatIndex].pointRadius;
+    float dist = distance(gl_FragCoord.xy, pointRadius.xy);
+    float splat = exp(-dist * dist / pointRadius.z) * pointRadius.w;
+    FragColor = vec4(splats[splatIndex].color.rgb * splat, 0.0);
+}
+)";
+
+    // Damped Jacobi smoother for the multigrid levels
+    const char* const smooth_fs = R"(
 #version 330 core
 out vec4 FragColor;
 in vec2 uv;
-uniform sampler2D base;
-uniform vec2 point;
-uniform vec3 color;
-uniform float radius;
-uniform float strength;
+uniform sampler2D pressure;
+uniform sampler2D divergence;
+layout(std140) uniform LevelConstants {
+    vec2 texelSize;
+    float h2;
+};
+uniform float omega;
+
+void main() {
+    float left = texture(pressure, uv - vec2(texelSize.x, 0.0)).r;
+    float right = texture(pressure, uv + vec2(texelSize.x, 0.0)).r;
+    float bottom = texture(pressure, uv - vec2(0.0, texelSize.y)).r;
+    float top = texture(pressure, uv + vec2(0.0, texelSize.y)).r;
+    float center = texture(pressure, uv).r;
+    float div = texture(divergence, uv).r;
+    
+    float jacobi = (left + right + bottom + top - h2 * div) * 0.25;
+    FragColor = vec4(mix(center, jacobi, omega), 0.0, 0.0, 1.0);
+}
+)";
+
+    // Fused vorticity confinement and divergence, written to two render
+    // targets. The divergence is linear, so div(u + dt * f) = div(u) +
+    // dt * div(f): the force is evaluated at this texel and at its four
+    // clamped neighbours instead of re-reading the confined velocity in
+    // another pass. Unfiltered fetches keep the five evaluations cheap.
+    const char* const confinement_divergence_fs = R"(
+#version 330 core
+layout(location = 0) out vec4 Velocity;
+layout(location = 1) out vec4 Divergence;
+uniform sampler2D velocity;
+uniform sampler2D vorticity;
+layout(std140) uniform FrameConstants {
+    vec2 texelSize;
+    float dt;
+    float advectionDt;
+    float confinementStrength;
+};
 
+ivec2 last;
+
+float curl(int x, int y) {
+    return texelFetch(vorticity, clamp(ivec2(x, y), ivec2(0), last), 0).r;
+}
+
+vec2 confinementForce(ivec2 c) {
+    float left = curl(c.x - 1, c.y);
+    float right = curl(c.x + 1, c.y);
+    float bottom = curl(c.x, c.y - 1);
+    float top = curl(c.x, c.y + 1);
+    float center = curl(c.x, c.y);
+
+    vec2 gradient = vec2(abs(right) - abs(left), abs(top) - abs(bottom)) * 0.5;
+    float len = length(gradient) + 1e-5;
+    gradient = gradient / len;
+
+    return vec2(gradient.y, -gradient.x) * center * confinementStrength;
+}
+
+void main() {
+    ivec2 cell = ivec2(gl_FragCoord.xy);
+    last = textureSize(vorticity, 0) - 1;
+    ivec2 left = ivec2(max(cell.x - 1, 0), cell.y);
+    ivec2 right = ivec2(min(cell.x + 1, last.x), cell.y);
+    ivec2 bottom = ivec2(cell.x, max(cell.y - 1, 0));
+    ivec2 top = ivec2(cell.x, min(cell.y + 1, last.y));
+
+    float velocityDivergence = 0.5 * ((texelFetch(velocity, right, 0).x - texelFetch(velocity, left, 0).x) +
+        (texelFetch(velocity, top, 0).y - texelFetch(velocity, bottom, 0).y));
+    float forceDivergence = 0.5 * ((confinementForce(right).x - confinementForce(left).x) +
+        (confinementForce(top).y - confinementForce(bottom).y));
+
+    vec2 vel = texelFetch(velocity, cell, 0).xy + confinementForce(cell) * dt;
+    Velocity = vec4(vel, 0.0, 1.0);
+    Divergence = vec4(velocityDivergence + forceDivergence * dt, 0.0, 0.0, 1.0);
+}
+)";
+
+    // Red-black SOR half-sweep. Texels of the given checkerboard parity get
+    // the over-relaxed Gauss-Seidel update, the others are copied through
+    const char* const sor_fs = R"(
+#version 330 core
+out vec4 FragColor;
+in vec2 uv;
+uniform sampler2D pressure;
+uniform sampler2D divergence;
+layout(std140) uniform LevelConstants {
+    vec2 texelSize;
+    float h2;
+};
+uniform float omega;
+uniform int parity;
+
+void main() {
+    float center = texture(pressure, uv).r;
+    ivec2 cell = ivec2(gl_FragCoord.xy);
+    if (((cell.x + cell.y) & 1) != parity) {
+        FragColor = vec4(center, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    float left = texture(pressure, uv - vec2(texelSize.x, 0.0)).r;
+    float right = texture(pressure, uv + vec2(texelSize.x, 0.0)).r;
+    float bottom = texture(pressure, uv - vec2(0.0, texelSize.y)).r;
+    float top = texture(pressure, uv + vec2(0.0, texelSize.y)).r;
+    float div = texture(divergence, uv).r;
+
+    float gaussSeidel = (left + right + bottom + top - h2 * div) * 0.25;
+    FragColor = vec4(mix(center, gaussSeidel, omega), 0.0, 0.0, 1.0);
+}
+)";
+
+    // Chebyshev semi-iterative Jacobi: p(k+1) = p(k-1) + omega * (J(p(k)) - p(k-1))
+    const char* const chebyshev_fs = R"(
+#version 330 core
+out vec4 FragColor;
+in vec2 uv;
+uniform sampler2D pressure;
+uniform sampler2D previousPressure;
+uniform sampler2D divergence;
+layout(std140) uniform LevelConstants {
+    vec2 texelSize;
+    float h2;
+};
+uniform float omega;
+
+void main() {
+    float left = texture(pressure, uv - vec2(texelSize.x, 0.0)).r;
+    float right = texture(pressure, uv + vec2(texelSize.x, 0.0)).r;
+    float bottom = texture(pressure, uv - vec2(0.0, texelSize.y)).r;
+    float top = texture(pressure, uv + vec2(0.0, texelSize.y)).r;
+    float previous = texture(previousPressure, uv).r;
+    float div = texture(divergence, uv).r;
+
+    float jacobi = (left + right + bottom + top - h2 * div) * 0.25;
+    FragColor = vec4(mix(previous, jacobi, omega), 0.0, 0.0, 1.0);
+}
+)";
+
+    // Residual of the pressure equation: r = div - laplacian(p) / h^2
+    const char* const residual_fs = R"(
+#version 330 core
+out vec4 FragColor;
+in vec2 uv;
+uniform sampler2D pressure;
+uniform sampler2D divergence;
+layout(std140) uniform LevelConstants {
+    vec2 texelSize;
+    float h2;
+};
+
+void main() {
+    float left = texture(pressure, uv - vec2(texelSize.x, 0.0)).r;
+    float right = texture(pressure, uv + vec2(texelSize.x, 0.0)).r;
+    float bottom = texture(pressure, uv - vec2(0.0, texelSize.y)).r;
+    float top = texture(pressure, uv + vec2(0.0, texelSize.y)).r;
+    float center = texture(pressure, uv).r;
+    float div = texture(divergence, uv).r;
+    
+    float laplacian = (left + right + bottom + top - 4.0 * center) / h2;
+    FragColor = vec4(div - laplacian, 0.0, 0.0, 1.0);
+}
+)";
+
+    // Restriction to the next coarser level (bilinear tap = 2x2 average)
+    const char* const restrict_fs = R"(
+#version 330 core
+out vec4 FragColor;
+in vec2 uv;
+uniform sampler2D fine;
+
+void main() {
+    FragColor = vec4(texture(fine, uv).r, 0.0, 0.0, 1.0);
+}
+)";
+
+    // Prolongation: add the bilinearly interpolated coarse correction
+    const char* const prolongate_fs = R"(
+#version 330 core
+out vec4 FragColor;
+in vec2 uv;
+uniform sampler2D pressure;
+uniform sampler2D correction;
+
+void main() {
+    float p = texture(pressure, uv).r + texture(correction, uv).r;
+    FragColor = vec4(p, 0.0, 0.0, 1.0);
+}
+)";
+
+    // One reduction pass: each output texel folds a 4x4 block of the source
+    // into (max, sum of squares, sum). mode 0 reads partials from a previous
+    // pass, mode 1 reduces the signed value r (max of |r|) and mode 2 reduces
+    // length(rg).
+    const char* const reduce_fs = R"(
+#version 330 core
+out vec4 FragColor;
+uniform sampler2D source;
+uniform ivec2 sourceSize;
+uniform int mode;
+
+void main() {
+    ivec2 base = ivec2(gl_FragCoord.xy) * 4;
+    float maxValue = 0.0;
+    float sumSquares = 0.0;
+    float sum = 0.0;
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            ivec2 p = base + ivec2(i, j);
+            if (p.x >= sourceSize.x || p.y >= sourceSize.y) continue;
+            vec4 t = texelFetch(source, p, 0);
+            if (mode == 0) {
+                maxValue = max(maxValue, t.r);
+                sumSquares += t.g;
+                sum += t.b;
+            }
+            else {
+                float v = mode == 1 ? t.r : length(t.rg);
+                maxValue = max(maxValue, abs(v));
+                sumSquares += v * v;
+                sum += v;
+            }
+        }
+    }
+    FragColor = vec4(maxValue, sumSquares, sum, 1.0);
+}
+)";
+
+    // Warm-start guess: linear extrapolation of the last two pressures
+    const char* const extrapolate_fs = R"(
+#version 330 core
+out vec4 FragColor;
+in vec2 uv;
+uniform sampler2D pressure;
+uniform sampler2D previousPressure;
+
+void main() {
+    // Damped by half: a full 2 * p1 - p0 feeds unconverged error from a
+    // short Jacobi solve back into the next step until it blows up
+    float p1 = texture(pressure, uv).r;
+    float p = p1 + 0.5 * (p1 - texture(previousPressure, uv).r);
+    FragColor = vec4(p, 0.0, 0.0, 1.0);
+}
+)";
+
+    // Subtracts the mean of a field, read from the 1x1 result of a GPU
+    // reduction (sum in .b)
+    const char* const remove_mean_fs = R"(
+#version 330 core
+out vec4 FragColor;
+in vec2 uv;
+uniform sampler2D field;
+uniform sampler2D sums;
+uniform float invCount;
+
+void main() {
+    float mean = texelFetch(sums, ivec2(0), 0).b * invCount;
+    FragColor = vec4(texture(field, uv).r - mean, 0.0, 0.0, 1.0);
+}
+)";
+
+    // Tiled Jacobi pressure solve (GL 4.3). Each work group loads a 16x16
+    // tile plus a halo of MAX_ITERATIONS texels into shared memory, runs up
+    // to MAX_ITERATIONS sweeps there with the valid region shrinking by one
+    // texel per sweep, and stores the tile centre. Neighbours are clamped to
+    // the grid like the clamp-to-edge fragment path, so results match it.
+    const char* const jacobi_tiled_cs = R"(
+#version 430 core
+#define TILE 16
+#define MAX_ITERATIONS 4
+#define SIZE (TILE + 2 * MAX_ITERATIONS)
+layout(local_size_x = TILE, local_size_y = TILE) in;
+
+layout(r32f, binding = 0) uniform writeonly image2D result;
+uniform sampler2D pressure;
+uniform sampler2D divergence;
+uniform ivec2 gridSize;
+uniform int iterations;
+uniform float alpha;
+uniform float beta;
+
+shared float tilePressure[2][SIZE * SIZE];
+shared float tileDivergence[SIZE * SIZE];
+
+void main() {
+    ivec2 origin = ivec2(gl_WorkGroupID.xy) * TILE - MAX_ITERATIONS;
+    ivec2 thread = ivec2(gl_LocalInvocationID.xy);
+    // Tiles touching the grid edge clamp their neighbours into the grid;
+    // interior tiles index shared memory directly
+    bool edge = any(lessThan(origin, ivec2(0))) || any(greaterThan(origin + SIZE, gridSize));
+
+    // Each thread owns up to 2x2 texels of the SIZE x SIZE region
+    for (int y = thread.y; y < SIZE; y += TILE) {
+        for (int x = thread.x; x < SIZE; x += TILE) {
+            ivec2 cell = clamp(origin + ivec2(x, y), ivec2(0), gridSize - 1);
+            tilePressure[0][y * SIZE + x] = texelFetch(pressure, cell, 0).r;
+            tileDivergence[y * SIZE + x] = texelFetch(divergence, cell, 0).r;
+        }
+    }
+    barrier();
+
+    int src = 0;
+    for (int k = 0; k < iterations; k++) {
+        // The valid region shrinks by one texel per sweep
+        int lo = k + 1;
+        int hi = SIZE - k - 1;
+        for (int y = thread.y; y < SIZE; y += TILE) {
+            for (int x = thread.x; x < SIZE; x += TILE) {
+                if (x < lo || y < lo || x >= hi || y >= hi) continue;
+                int i = y * SIZE + x;
+                int left = i - 1, right = i + 1, bottom = i - SIZE, top = i + SIZE;
+                if (edge) {
+                    ivec2 cell = origin + ivec2(x, y);
+                    if (any(lessThan(cell, ivec2(0))) || any(greaterThanEqual(cell, gridSize))) continue;
+                    if (cell.x == 0) left = i;
+                    if (cell.y == 0) bottom = i;
+                    if (cell.x == gridSize.x - 1) right = i;
+                    if (cell.y == gridSize.y - 1) top = i;
+                }
+                tilePressure[1 - src][i] = (tilePressure[src][left] + tilePressure[src][right] +
+                    tilePressure[src][bottom] + tilePressure[src][top] + alpha * tileDivergence[i]) * beta;
+            }
+        }
+        barrier();
+        src = 1 - src;
+    }
+
+    ivec2 cell = ivec2(gl_GlobalInvocationID.xy);
+    if (all(lessThan(cell, gridSize))) {
+        int i = (thread.y + MAX_ITERATIONS) * SIZE + thread.x + MAX_ITERATIONS;
+        imageStore(result, cell, vec4(tilePressure[src][i], 0.0, 0.0, 0.0));
+    }
+}
+)";
+
+    // Sparse stepping. Tile lists live in one buffer: two DrawArraysIndirect
+    // commands (active tiles, then tiles retired since the last update)
+    // followed by four tileCount-long regions: the active list, the retired
+    // list, each tile's previous state and its raw moving flag. Tiles are
+    // packed as x | y << 16.
+
+    // Flags the tiles of one 16x16 workgroup that hold any texel faster than
+    // the threshold
+    const char* const tile_mask_cs = R"(
+#version 430 core
+layout(local_size_x = 16, local_size_y = 16) in;
+layout(std430, binding = 0) buffer TileLists {
+    uint commands[8];
+    uint tiles[];
+};
+uniform sampler2D velocity;
+uniform ivec2 gridSize;
+uniform int tileCount;
+uniform float threshold;
+shared uint moving;
+
+void main() {
+    if (gl_LocalInvocationIndex == 0u) moving = 0u;
+    barrier();
+    ivec2 cell = ivec2(gl_GlobalInvocationID.xy);
+    if (all(lessThan(cell, gridSize)) && length(texelFetch(velocity, cell, 0).xy) > threshold) {
+        atomicOr(moving, 1u);
+    }
+    barrier();
+    if (gl_LocalInvocationIndex == 0u) {
+        uint tile = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+        tiles[3u * uint(tileCount) + tile] = moving;
+    }
+}
+)";
+
+    // Dilates the moving flags into the active set and appends each tile to
+    // the active list, or to the retired list if it was active before
+    const char* const tile_list_cs = R"(
+#version 430 core
+layout(local_size_x = 8, local_size_y = 8) in;
+layout(std430, binding = 0) buffer TileLists {
+    uint commands[8];
+    uint tiles[];
+};
+uniform ivec2 tileGrid;
+uniform int tileCount;
+uniform int dilation;
+
+void main() {
+    ivec2 tile = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(tile, tileGrid))) return;
+
+    uint count = uint(tileCount);
+    bool stepped = false;
+    for (int dy = -dilation; dy <= dilation; dy++) {
+        for (int dx = -dilation; dx <= dilation; dx++) {
+            ivec2 n = tile + ivec2(dx, dy);
+            if (all(greaterThanEqual(n, ivec2(0))) && all(lessThan(n, tileGrid)) &&
+                tiles[3u * count + uint(n.y * tileGrid.x + n.x)] != 0u) {
+                stepped = true;
+            }
+        }
+    }
+
+    uint index = uint(tile.y * tileGrid.x + tile.x);
+    bool wasActive = tiles[2u * count + index] != 0u;
+    tiles[2u * count + index] = stepped ? 1u : 0u;
+    uint entry = uint(tile.x) | (uint(tile.y) << 16);
+    if (stepped) {
+        tiles[atomicAdd(commands[1], 1u)] = entry;
+    }
+    else if (wasActive) {
+        tiles[count + atomicAdd(commands[5], 1u)] = entry;
+    }
+}
+)";
+
+    // Vertex shader drawing one instance per listed tile, with the same uv
+    // as the fullscreen quad over the tile's texels. Any field resolution
+    // works, since tiles are placed in uv.
+    const char* const tile_vs = R"(
+#version 330 core
+layout(location = 0) in vec2 aPos;
+layout(location = 1) in vec2 aUV;
+out vec2 uv;
+uniform usamplerBuffer tiles;
+uniform int listOffset;
+uniform vec2 tileExtent;    // one tile in uv
+
+void main() {
+    uint entry = texelFetch(tiles, listOffset + gl_InstanceID).r;
+    vec2 tile = vec2(float(entry & 0xFFFFu), float(entry >> 16));
+    uv = min((tile + aUV) * tileExtent, vec2(1.0));
+    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+    // Copies the read target over the write target texel for texel
+    const char* const copy_fs = R"(
+#version 330 core
+out vec4 FragColor;
+uniform sampler2D source;
 void main() {
-    vec4 baseColor = texture(base, uv);
-    float dist = distance(gl_FragCoord.xy, point);
-    float splat = exp(-dist * dist / radius) * strength;
-    FragColor = baseColor + vec4(color * splat, 0.0);
+    FragColor = texelFetch(source, ivec2(gl_FragCoord.xy), 0);
 }
 )";
 }
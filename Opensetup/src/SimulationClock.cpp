@@ -0,0 +1,36 @@
+#include "SimulationClock.h"
+#include <algorithm>
+
+const double SimulationClock::minAdaptiveStep = 1.0 / 240.0;
+const double SimulationClock::maxAdaptiveStep = 1.0 / 10.0;
+
+SimulationClock::SimulationClock(double rate, int maxSubsteps)
+    : stepSeconds(1.0 / rate), maxSubsteps(maxSubsteps), accumulator(0.0),
+    simulatedTime(0.0), droppedTime(0.0) {
+}
+
+void SimulationClock::setStep(double seconds) {
+    double fraction = accumulator / stepSeconds;
+    stepSeconds = seconds;
+    accumulator = fraction * stepSeconds;
+}
+
+double SimulationClock::clampAdaptiveStep(double stable) {
+    return std::min(std::max(stable, minAdaptiveStep), maxAdaptiveStep);
+}
+
+int SimulationClock::advance(double elapsed) {
+    accumulator += std::max(elapsed, 0.0);
+
+    int steps = (int)(accumulator / stepSeconds);
+    if (steps > maxSubsteps) {
+        // Keep the fraction so the interpolation does not jump
+        double excess = (steps - maxSubsteps) * stepSeconds;
+        droppedTime += excess;
+        accumulator -= excess;
+        steps = maxSubsteps;
+    }
+    accumulator -= steps * stepSeconds;
+    simulatedTime += steps * stepSeconds;
+    return steps;
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef SIMULATION_CLOCK_H
+#define SIMULATION_CLOCK_H
+
+// Fixed-timestep accumulator that decouples the simulation rate from the
+// frame rate. Each frame adds the elapsed wall-clock time and runs as many
+// whole steps as have accumulated, from none up to maxSubsteps. Time beyond
+// the cap is dropped rather than carried over, so a stall slows simulated
+// time down instead of triggering ever longer catch-up frames.
+class SimulationClock {
+public:
+    explicit SimulationClock(double rate = 60.0, int maxSubsteps = 4);
+
+    void setRate(double rate) { setStep(1.0 / rate); }
+    double getRate() const { return 1.0 / stepSeconds; }
+    // Changing the step keeps the interpolation fraction, so a step that
+    // adapts every frame does not make the display jump
+    void setStep(double seconds);
+    // Sets a CFL-limited step, clamped to [minAdaptiveStep, maxAdaptiveStep]
+    void setAdaptiveStep(double stable) { setStep(clampAdaptiveStep(stable)); }
+
+    // Bounds of a CFL-driven step: the lower one keeps the catch-up cap from
+    // starving the clock in violent flow, the upper one keeps the force and
+    // confinement terms accurate in a still scene
+    static const double minAdaptiveStep;
+    static const double maxAdaptiveStep;
+    static double clampAdaptiveStep(double stable);
+    float getStep() const { return (float)stepSeconds; }
+    void setMaxSubsteps(int count) { maxSubsteps = count; }
+    int getMaxSubsteps() const { return maxSubsteps; }
+
+    // Adds elapsed seconds and returns the number of steps to run now
+    int advance(double elapsed);
+    // Fraction of a step accumulated since the last one, in [0, 1), for
+    // blending the last two states at display time
+    float getInterpolation() const { return (float)(accumulator / stepSeconds); }
+
+    double getSimulatedTime() const { return simulatedTime; }
+    // Wall-clock seconds discarded by the catch-up cap
+    double getDroppedTime() const { return droppedTime; }
+
+private:
+    double stepSeconds;
+    int maxSubsteps;
+    double accumulator;
+    double simulatedTime;
+    double droppedTime;
+};
+
+#endif
\ No newline at end of file
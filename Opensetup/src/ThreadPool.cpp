@@ -0,0 +1,86 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount)
+    : job(nullptr), jobBegin(0), jobEnd(0), chunkSize(1), chunkCount(0),
+    nextChunk(0), activeWorkers(0), generation(0), stopping(false) {
+    if (threadCount <= 0) {
+        threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    // The calling thread also runs chunks, so spawn one fewer worker
+    for (int i = 1; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int, int)>& fn) {
+    if (end <= begin) return;
+    if (workers.empty()) {
+        fn(begin, end);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobBegin = begin;
+        jobEnd = end;
+        // A few chunks per thread keeps the load balanced without much overhead
+        chunkCount = std::min(end - begin, size() * 4);
+        chunkSize = (end - begin + chunkCount - 1) / chunkCount;
+        nextChunk = 0;
+        activeWorkers = (int)workers.size();
+        generation++;
+    }
+    wakeCondition.notify_all();
+
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this] { return activeWorkers == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::workerLoop() {
+    TRACE_THREAD_NAME("pool worker");
+    unsigned seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) return;
+            seenGeneration = generation;
+        }
+
+        runChunks();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--activeWorkers == 0) {
+            doneCondition.notify_one();
+        }
+    }
+}
+
+void ThreadPool::runChunks() {
+    TRACE_ZONE("parallel for");
+    int chunk;
+    while ((chunk = nextChunk.fetch_add(1)) < chunkCount) {
+        int b = jobBegin + chunk * chunkSize;
+        int e = std::min(b + chunkSize, jobEnd);
+        if (b < e) {
+            (*job)(b, e);
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker pool used by the CPU backend. parallelFor() splits a row
+// range into chunks that the workers and the calling thread pull from an
+// atomic counter, and returns once every chunk has run.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threadCount = 0);
+    ~ThreadPool();
+
+    int size() const { return (int)workers.size() + 1; }
+    void parallelFor(int begin, int end, const std::function<void(int, int)>& fn);
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+
+    const std::function<void(int, int)>* job;
+    int jobBegin, jobEnd, chunkSize, chunkCount;
+    std::atomic<int> nextChunk;
+    int activeWorkers;
+    unsigned generation;
+    bool stopping;
+
+    void workerLoop();
+    void runChunks();
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "TileActivity.h"
+#include "ShaderSources.h"
+#include "GLExtensions.h"
+#include <vector>
+
+namespace {
+    // Words before the lists: two DrawArraysIndirectCommands
+    const int commandWords = 8;
+    const GLuint listBinding = 0;
+    // Kept clear of the units the simulation passes bind
+    const int listTextureUnit = 7;
+}
+
+TileActivity::TileActivity()
+    : gridW(0), gridH(0), tilesX(0), tilesY(0), listBuffer(0), listTexture(0) {
+}
+
+TileActivity::~TileActivity() {
+    destroy();
+}
+
+void TileActivity::destroy() {
+    glDeleteTextures(1, &listTexture);
+    glDeleteBuffers(1, &listBuffer);
+    listTexture = 0;
+    listBuffer = 0;
+}
+
+void TileActivity::init(int width, int height) {
+    if (!maskShader) {
+        maskShader = std::make_unique<Shader>(ShaderSources::tile_mask_cs);
+        listShader = std::make_unique<Shader>(ShaderSources::tile_list_cs);
+        copyShader = std::make_unique<Shader>(ShaderSources::tile_vs, ShaderSources::copy_fs);
+        maskShader->finish();
+        listShader->finish();
+        copyShader->finish();
+        maskShader->bindSamplers({ "velocity" });
+        copyShader->bindSamplers({ "source" });
+        quad.init();
+    }
+
+    destroy();
+    gridW = width;
+    gridH = height;
+    tilesX = (width + tileSize - 1) / tileSize;
+    tilesY = (height + tileSize - 1) / tileSize;
+    int tileCount = tilesX * tilesY;
+
+    // Commands, then the active list, the retired list, the previous state
+    // and the moving flags, tileCount words each
+    std::vector<GLuint> words(commandWords + 4 * tileCount, 0);
+    for (int i = 0; i < tileCount; i++) {
+        words[commandWords + 2 * tileCount + i] = 1;
+    }
+    glGenBuffers(1, &listBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, listBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, words.size() * sizeof(GLuint), words.data(), GL_DYNAMIC_COPY);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGenTextures(1, &listTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, listTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, listBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    configure(*copyShader, commandWords + tileCount);
+    glUseProgram(0);
+}
+
+void TileActivity::update(GLuint velocity, float threshold, int dilation) {
+    // Six vertices a tile, no instances yet; the list pass counts them up
+    const GLuint commands[commandWords] = { 6, 0, 0, 0, 6, 0, 0, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, listBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(commands), commands);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, listBinding, listBuffer);
+
+    int tileCount = tilesX * tilesY;
+    maskShader->use();
+    maskShader->setIVec2("gridSize", gridW, gridH);
+    maskShader->setInt("tileCount", tileCount);
+    maskShader->setFloat("threshold", threshold);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, velocity);
+    glDispatchCompute(tilesX, tilesY, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    listShader->use();
+    listShader->setIVec2("tileGrid", tilesX, tilesY);
+    listShader->setInt("tileCount", tileCount);
+    listShader->setInt("dilation", dilation);
+    glDispatchCompute((tilesX + 7) / 8, (tilesY + 7) / 8, 1);
+
+    // The lists feed indirect draws and texel fetches in tile_vs
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, listBinding, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void TileActivity::configure(const Shader& shader) const {
+    configure(shader, commandWords);
+}
+
+void TileActivity::configure(const Shader& shader, int listOffset) const {
+    shader.use();
+    shader.setInt("tiles", listTextureUnit);
+    shader.setInt("listOffset", listOffset);
+    shader.setVec2("tileExtent", (float)tileSize / gridW, (float)tileSize / gridH);
+}
+
+void TileActivity::bindLists() const {
+    glActiveTexture(GL_TEXTURE0 + listTextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, listTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, listBuffer);
+}
+
+void TileActivity::drawActive() const {
+    bindLists();
+    quad.bind();
+    glDrawArraysIndirect(GL_TRIANGLES, (const void*)0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void TileActivity::copyRetired(const DoubleRenderTarget& field) const {
+    field.write().bind();
+    copyShader->use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, field.read().texture);
+    bindLists();
+    quad.bind();
+    glDrawArraysIndirect(GL_TRIANGLES, (const void*)(4 * sizeof(GLuint)));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+int TileActivity::readActiveCount() const {
+    GLuint count = 0;
+    glBindBuffer(GL_TEXTURE_BUFFER, listBuffer);
+    glGetBufferSubData(GL_TEXTURE_BUFFER, sizeof(GLuint), sizeof(GLuint), &count);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    return (int)count;
+}
\ No newline at end of file
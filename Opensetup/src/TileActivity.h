@@ -0,0 +1,63 @@
+#ifndef TILE_ACTIVITY_H
+#define TILE_ACTIVITY_H
+
+#include <glad/glad.h>
+#include <memory>
+#include "Shader.h"
+#include "Quad.h"
+#include "RenderTarget.h"
+
+// Tracks which 16x16-texel tiles of the velocity grid are moving, so the
+// transport passes can skip the still parts of the domain. Each update a
+// compute pass flags the tiles holding a texel faster than a threshold, and
+// a second one dilates the flags and builds two lists in a buffer object:
+// the active tiles, and the tiles retired since the last update. The lists
+// are drawn with glDrawArraysIndirect, one instanced quad per tile, so the
+// CPU never reads the counts back. Needs GL 4.3 (see GLExtensions).
+//
+// Passes limited to the active tiles leave the rest of a ping-pong target
+// alone, so skipped tiles must hold the same values in both buffers:
+// copyRetired() brings a tile's second buffer up to date when it stops.
+class TileActivity {
+public:
+    static const int tileSize = 16;     // local size of tile_mask_cs
+
+    TileActivity();
+    ~TileActivity();
+
+    // Every tile starts out as active before the first update, so the first
+    // update retires (and copies) whatever is still
+    void init(int width, int height);
+
+    // threshold is on |u|; dilation is in tiles and lets motion spread into
+    // the ring around the moving tiles before they are stepped
+    void update(GLuint velocity, float threshold, int dilation);
+
+    // Points a tile_vs program at the active list
+    void configure(const Shader& shader) const;
+    // One instance per active tile, with the current framebuffer and program
+    void drawActive() const;
+    // Copies the read buffer over the write buffer in the retired tiles
+    void copyRetired(const DoubleRenderTarget& field) const;
+
+    int getTileCount() const { return tilesX * tilesY; }
+    // Reads the active count back; stalls, so for reports only
+    int readActiveCount() const;
+
+private:
+    int gridW, gridH;
+    int tilesX, tilesY;
+    GLuint listBuffer;      // commands and tile lists (layout in ShaderSources.h)
+    GLuint listTexture;     // the same buffer as a texture for tile_vs
+
+    std::unique_ptr<Shader> maskShader;
+    std::unique_ptr<Shader> listShader;
+    std::unique_ptr<Shader> copyShader;
+    Quad quad;
+
+    void destroy();
+    void bindLists() const;
+    void configure(const Shader& shader, int listOffset) const;
+};
+
+#endif
\ No newline at end of file
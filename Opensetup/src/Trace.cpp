@@ -0,0 +1,191 @@
+#include "Trace.h"
+
+#ifdef FLUID_ENABLE_TRACING
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace {
+    struct Event {
+        const char* name;
+        int64_t start;      // ns since the trace epoch
+        int64_t duration;   // ns, negative for an instant
+    };
+
+    // Buffers grow by blocks, so published events never move
+    const size_t blockEvents = 4096;
+    // Caps a thread at about 24 MiB of events; later ones are dropped
+    const size_t maxEvents = 1 << 20;
+
+    struct Block {
+        Event events[blockEvents];
+        std::atomic<Block*> next;
+        Block() : next(nullptr) {}
+    };
+
+    struct ThreadBuffer {
+        Block* first;
+        Block* last;                    // writer only
+        std::atomic<size_t> count;      // events published
+        std::atomic<size_t> dropped;
+        int id;
+        std::string name;               // guarded by registryMutex
+    };
+
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    // Buffers are registered once per thread and never freed, so a thread
+    // that exits leaves its events behind for the next write
+    std::mutex registryMutex;
+    std::vector<ThreadBuffer*> registry;
+    thread_local ThreadBuffer* localBuffer = nullptr;
+
+    std::string outputPath;
+    bool exitHandlerRegistered = false;
+
+    int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    ThreadBuffer* threadBuffer() {
+        if (!localBuffer) {
+            ThreadBuffer* buffer = new ThreadBuffer();
+            buffer->first = new Block();
+            buffer->last = buffer->first;
+            buffer->count.store(0);
+            buffer->dropped.store(0);
+            std::lock_guard<std::mutex> lock(registryMutex);
+            buffer->id = (int)registry.size() + 1;
+            registry.push_back(buffer);
+            localBuffer = buffer;
+        }
+        return localBuffer;
+    }
+
+    void record(const char* name, int64_t start, int64_t duration) {
+        ThreadBuffer* buffer = threadBuffer();
+        size_t index = buffer->count.load(std::memory_order_relaxed);
+        if (index >= maxEvents) {
+            buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        size_t slot = index % blockEvents;
+        if (slot == 0 && index > 0) {
+            Block* block = new Block();
+            buffer->last->next.store(block, std::memory_order_release);
+            buffer->last = block;
+        }
+        Event& event = buffer->last->events[slot];
+        event.name = name;
+        event.start = start;
+        event.duration = duration;
+        // Readers take only events below the published count
+        buffer->count.store(index + 1, std::memory_order_release);
+    }
+
+    void writeString(std::ostream& out, const char* text) {
+        out << '"';
+        for (const char* c = text; *c; c++) {
+            if (*c == '"' || *c == '\\') out << '\\';
+            out << *c;
+        }
+        out << '"';
+    }
+
+    void writeAtExit() {
+        Trace::write();
+    }
+}
+
+namespace Trace {
+
+Zone::Zone(const char* name)
+    : name(name), start(now()) {
+}
+
+Zone::~Zone() {
+    record(name, start, now() - start);
+}
+
+void instant(const char* name) {
+    record(name, now(), -1);
+}
+
+void setThreadName(const char* name) {
+    ThreadBuffer* buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer->name = name;
+}
+
+void setOutputPath(const std::string& path) {
+    outputPath = path;
+    if (!exitHandlerRegistered && !path.empty()) {
+        std::atexit(writeAtExit);
+        exitHandlerRegistered = true;
+    }
+}
+
+bool write() {
+    return !outputPath.empty() && write(outputPath);
+}
+
+bool write(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cout << "Could not write trace " << path << std::endl;
+        return false;
+    }
+
+    // Timestamps are in microseconds, with the nanoseconds as decimals
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << std::endl;
+    out << std::fixed << std::setprecision(3);
+    bool first = true;
+    size_t written = 0, dropped = 0;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const ThreadBuffer* buffer : registry) {
+        if (!buffer->name.empty()) {
+            out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->id
+                << ",\"args\":{\"name\":";
+            writeString(out, buffer->name.c_str());
+            out << "}}";
+            first = false;
+        }
+
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        const Block* block = buffer->first;
+        for (size_t i = 0; i < count; i++) {
+            if (i > 0 && i % blockEvents == 0) {
+                block = block->next.load(std::memory_order_acquire);
+            }
+            const Event& event = block->events[i % blockEvents];
+            out << (first ? "" : ",\n") << "{\"name\":";
+            writeString(out, event.name);
+            out << ",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":" << event.start * 1e-3;
+            if (event.duration >= 0) {
+                out << ",\"ph\":\"X\",\"dur\":" << event.duration * 1e-3 << "}";
+            }
+            else {
+                out << ",\"ph\":\"i\",\"s\":\"t\"}";
+            }
+            first = false;
+        }
+        written += count;
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    out << "\n]}" << std::endl;
+
+    std::cout << "Wrote " << written << " trace events to " << path;
+    if (dropped > 0) std::cout << " (" << dropped << " dropped)";
+    std::cout << std::endl;
+    return true;
+}
+
+}
+
+#endif
\ No newline at end of file
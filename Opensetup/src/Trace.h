@@ -0,0 +1,73 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+
+// CPU-side scoped zones for a timeline of the frame loop: driver submission,
+// blocking swaps, shader builds and input handling. Each thread appends to
+// its own buffer without locking (the writer publishes a count, readers take
+// only what was published), with nanosecond steady-clock timestamps. The
+// events are written as Chrome trace-event JSON, which chrome://tracing and
+// Perfetto open, on demand with write() or at exit after setOutputPath().
+//
+// Everything compiles to nothing unless FLUID_ENABLE_TRACING is defined.
+#ifdef FLUID_ENABLE_TRACING
+
+#include <cstdint>
+
+namespace Trace {
+    const bool enabled = true;
+
+    class Zone {
+    public:
+        explicit Zone(const char* name);
+        ~Zone();
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+    private:
+        const char* name;   // must outlive the trace, e.g. a literal
+        int64_t start;
+    };
+
+    // A point in time, e.g. an input event arriving
+    void instant(const char* name);
+    // Label for the calling thread in the viewer
+    void setThreadName(const char* name);
+
+    // The trace is written here at exit; an empty path writes nothing
+    void setOutputPath(const std::string& path);
+    // Writes everything recorded so far to the output path, or to the
+    // given one. Recording threads are not stopped.
+    bool write();
+    bool write(const std::string& path);
+}
+
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+#define TRACE_ZONE(name) Trace::Zone TRACE_JOIN(traceZone, __LINE__)(name)
+#define TRACE_INSTANT(name) Trace::instant(name)
+#define TRACE_THREAD_NAME(name) Trace::setThreadName(name)
+
+#else
+
+namespace Trace {
+    const bool enabled = false;
+
+    // Empty, so members and locals of it vanish too
+    class Zone {
+    public:
+        explicit Zone(const char*) {}
+    };
+
+    inline void setOutputPath(const std::string&) {}
+    inline bool write() { return false; }
+    inline bool write(const std::string&) { return false; }
+}
+
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_INSTANT(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+
+#endif
+
+#endif
\ No newline at end of file
@@ -1,8 +1,623 @@
 ﻿#include "Application.h"
+#include "HeadlessContext.h"
+#include "CpuFluidSimulation.h"
+#include "ShaderCache.h"
+#include "Trace.h"
+#include <algorithm>
 #include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <string>
+
+struct Options {
+    bool headless = false;
+    bool compare = false;
+    bool pressureBenchmark = false;
+    bool precisionCompare = false;
+    bool fusedPasses = false;
+    std::string backend = "gpu";
+    std::string solver = "jacobi";
+    std::string warmStart = "zero";
+    std::string pressurePath = "auto";
+    std::string precision = "full";
+    std::string shaderCache;    // program binary cache directory, empty disables it
+    int steps = 1000;
+    int gridSize = 512;
+    int dyeGridSize = 0;    // 0 matches the grid
+    double stepBudget = 0.0;    // ms per step for dynamic resolution, 0 keeps the grid
+    int threads = 0;
+    int iterations = 0;     // pressure iterations per step, 0 keeps the default
+    float tolerance = 0.0f;
+    double simulationRate = 60.0;   // interactive steps per second
+    float courant = 0.0f;           // CFL-driven timestep when positive
+    bool sparse = false;
+    float sparseThreshold = 0.0f;   // 0 keeps the default
+    bool profile = false;
+    std::string profileCsv;         // empty prints the profile only
+    std::string trace;              // Chrome trace written at exit
+    double frameBudget = 1000.0 / 60.0; // interactive frame time budget in ms
+    std::string frameCsv;           // per-frame timings, empty writes none
+};
+
+static bool parsePressureSolver(const std::string& name, PressureSolver& solver) {
+    if (name == "jacobi") solver = PressureSolver::Jacobi;
+    else if (name == "sor") solver = PressureSolver::RedBlackSOR;
+    else if (name == "chebyshev") solver = PressureSolver::ChebyshevJacobi;
+    else if (name == "multigrid") solver = PressureSolver::Multigrid;
+    else return false;
+    return true;
+}
+
+static bool parsePressureWarmStart(const std::string& name, PressureWarmStart& mode) {
+    if (name == "zero") mode = PressureWarmStart::Zero;
+    else if (name == "previous") mode = PressureWarmStart::Previous;
+    else if (name == "extrapolate") mode = PressureWarmStart::Extrapolate;
+    else return false;
+    return true;
+}
+
+static bool parsePressurePath(const std::string& name, PressurePath& path) {
+    if (name == "auto") path = PressurePath::Auto;
+    else if (name == "compute") path = PressurePath::Compute;
+    else if (name == "fragment") path = PressurePath::Fragment;
+    else return false;
+    return true;
+}
+
+static bool parseFieldPrecision(const std::string& name, FieldPrecision& precision) {
+    if (name == "full") precision = FieldPrecision::Full;
+    else if (name == "half") precision = FieldPrecision::Half;
+    else if (name == "packed") precision = FieldPrecision::Packed;
+    else return false;
+    return true;
+}
+
+static SparseSettings sparseSettings(const Options& options) {
+    SparseSettings settings;
+    settings.enabled = options.sparse;
+    if (options.sparseThreshold > 0.0f) settings.velocityThreshold = options.sparseThreshold;
+    return settings;
+}
+
+static bool parsePressureOptions(const Options& options, PressureOptions& pressure) {
+    if (!parsePressureSolver(options.solver, pressure.solver)) {
+        std::cout << "Unknown pressure solver: " << options.solver << std::endl;
+        return false;
+    }
+    if (!parsePressureWarmStart(options.warmStart, pressure.warmStart)) {
+        std::cout << "Unknown warm start: " << options.warmStart << std::endl;
+        return false;
+    }
+    if (!parsePressurePath(options.pressurePath, pressure.path)) {
+        std::cout << "Unknown pressure path: " << options.pressurePath << std::endl;
+        return false;
+    }
+    if (options.tolerance > 0.0f) {
+        pressure.adaptive.enabled = true;
+        pressure.adaptive.tolerance = options.tolerance;
+    }
+    pressure.iterations = options.iterations;
+    return true;
+}
+
+// The first given option that the CPU engine, plain Jacobi sweeps on fp32
+// fields, has no equivalent for, or null. A GPU/CPU comparison only runs
+// the plain solve, but accepts the options that change how the GPU runs it.
+static const char* cpuUnsupportedOption(const Options& options, bool comparison) {
+    if (options.solver != "jacobi") return "--solver";
+    if (options.tolerance > 0.0f) return "--tolerance";
+    if (options.warmStart != "zero") return "--warm-start";
+    if (comparison) return nullptr;
+    if (options.pressurePath != "auto") return "--pressure-path";
+    if (options.fusedPasses) return "--fused-passes";
+    if (options.precision != "full") return "--precision";
+    if (options.sparse) return "--sparse";
+    if (options.dyeGridSize > 0) return "--dye-grid";
+    if (options.stepBudget > 0.0) return "--step-budget";
+    if (options.courant > 0.0f) return "--cfl";
+    if (options.profile) return "--profile";
+    return nullptr;
+}
+
+static int runHeadless(const Options& options) {
+    // Time to first step covers context creation, shader builds (or cache
+    // loads), allocation and the first step itself
+    auto launch = std::chrono::steady_clock::now();
+
+    // The context must outlive the solver, so it is declared first
+    HeadlessContext context;
+    std::unique_ptr<FluidSolver> solver;
+    FluidSimulation* gpuSolver = nullptr;
+
+    if (options.backend == "cpu") {
+        if (const char* option = cpuUnsupportedOption(options, false)) {
+            std::cout << option << " is not supported by the cpu backend" << std::endl;
+            return -1;
+        }
+        auto cpuSim = std::make_unique<CpuFluidSimulation>(options.gridSize, options.gridSize, options.threads);
+        std::cout << "CPU backend: " << cpuSim->getThreadCount() << " threads" << std::endl;
+        if (options.iterations > 0) {
+            cpuSim->setPressureIterations(options.iterations);
+        }
+        solver = std::move(cpuSim);
+    }
+    else {
+        if (!context.initialize()) {
+            std::cout << "Failed to create headless context" << std::endl;
+            return -1;
+        }
+        auto gpuSim = std::make_unique<FluidSimulation>(options.gridSize, options.gridSize);
+        PressureOptions pressure;
+        if (!parsePressureOptions(options, pressure)) {
+            return -1;
+        }
+        gpuSim->setPressureOptions(pressure);
+        FieldPrecision precision;
+        if (!parseFieldPrecision(options.precision, precision)) {
+            std::cout << "Unknown precision: " << options.precision << std::endl;
+            return -1;
+        }
+        gpuSim->setFieldPrecision(precision);
+        gpuSim->setFusedPasses(options.fusedPasses);
+        gpuSim->setVelocityMonitoring(options.courant > 0.0f);
+        gpuSim->setDyeResolution(options.dyeGridSize, options.dyeGridSize);
+        gpuSim->setSparseSettings(sparseSettings(options));
+        gpuSolver = gpuSim.get();
+        solver = std::move(gpuSim);
+    }
+
+    const float dt = 0.016f;
+    solver->init();
+    solver->step(dt);
+    solver->finish();
+    double firstStep = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - launch).count();
+    std::cout << "Time to first step: " << firstStep << " ms";
+    if (gpuSolver) {
+        const ShaderCache::Stats& cache = ShaderCache::getStats();
+        std::cout << " (shader programs: " << cache.loaded << " cached, " << cache.compiled << " compiled";
+        if (!ShaderCache::isEnabled()) std::cout << ", cache off";
+        std::cout << ")";
+    }
+    std::cout << std::endl;
+    if (gpuSolver) {
+        std::cout << "Jacobi pressure path: " << (gpuSolver->isUsingComputeShaders() ? "compute" : "fragment") << std::endl;
+    }
+
+    std::unique_ptr<GpuProfiler> profiler;
+    if (gpuSolver && options.profile) {
+        profiler = std::make_unique<GpuProfiler>();
+        gpuSolver->setProfiler(profiler.get());
+    }
+
+    std::unique_ptr<ResolutionController> resolutionController;
+    if (gpuSolver && options.stepBudget > 0.0) {
+        ResolutionSettings settings;
+        settings.budgetMs = options.stepBudget;
+        resolutionController = std::make_unique<ResolutionController>();
+        resolutionController->setSettings(settings);
+    }
+
+    // The first step is not part of the throughput figure
+    double simulatedTime = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.steps; i++) {
+        float stepDt = dt;
+        if (gpuSolver && options.courant > 0.0f) {
+            float stable = gpuSolver->getStableTimestep(options.courant);
+            if (stable > 0.0f) stepDt = (float)SimulationClock::clampAdaptiveStep(stable);
+        }
+        if (resolutionController) resolutionController->begin();
+        if (profiler) profiler->beginFrame();
+        solver->step(stepDt);
+        if (profiler) profiler->endFrame();
+        simulatedTime += stepDt;
+        if (resolutionController) {
+            resolutionController->end(1);
+            int width, height;
+            if (resolutionController->update(gpuSolver->getWidth(), gpuSolver->getHeight(), width, height)) {
+                std::cout << "Step " << i << ": " << resolutionController->getAverageStepMs() << " ms/step, grid "
+                    << gpuSolver->getWidth() << "x" << gpuSolver->getHeight() << " -> " << width << "x" << height << std::endl;
+                gpuSolver->resize(width, height);
+            }
+        }
+    }
+    solver->finish();
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    // The step budget may have resized the grid
+    int gridW = gpuSolver ? gpuSolver->getWidth() : options.gridSize;
+    int gridH = gpuSolver ? gpuSolver->getHeight() : options.gridSize;
+    std::cout << "Headless (" << options.backend << "): " << options.steps << " steps at "
+        << gridW << "x" << gridH;
+    if (gpuSolver && (gpuSolver->getDyeWidth() != gridW || gpuSolver->getDyeHeight() != gridH)) {
+        std::cout << " (dye " << gpuSolver->getDyeWidth() << "x" << gpuSolver->getDyeHeight() << ")";
+    }
+    std::cout << " in " << seconds << "s (" << (options.steps / seconds) << " steps/s)" << std::endl;
+    if (gpuSolver) {
+        std::cout << "Pressure: " << gpuSolver->getPressureStats().iterationsPerStep() << " iterations/step";
+        if (gpuSolver->getLastPressureResidual() >= 0.0f) {
+            std::cout << ", last residual " << gpuSolver->getLastPressureResidual();
+        }
+        std::cout << std::endl;
+    }
+    if (gpuSolver && options.courant > 0.0f) {
+        std::cout << "CFL " << options.courant << ": " << simulatedTime << " s simulated, mean step "
+            << (1000.0 * simulatedTime / std::max(options.steps, 1)) << " ms, max |u| "
+            << gpuSolver->getMaxVelocity() << std::endl;
+    }
+    if (profiler) {
+        profiler->collect();
+        std::cout << "GPU time per step:" << std::endl;
+        profiler->print(std::cout);
+        if (!options.profileCsv.empty()) {
+            std::ofstream csv(options.profileCsv);
+            if (!csv) {
+                std::cout << "Could not open " << options.profileCsv << std::endl;
+                return -1;
+            }
+            GpuProfiler::writeCsvHeader(csv);
+            profiler->writeCsv(csv, seconds);
+        }
+    }
+    if (gpuSolver && gpuSolver->isSparse()) {
+        std::cout << "Sparse: " << gpuSolver->readActiveTiles() << " of " << gpuSolver->getTileCount()
+            << " tiles active in the last step" << std::endl;
+    }
+    return 0;
+}
+
+static void reportDifference(const char* name, const std::vector<float>& a, const std::vector<float>& b) {
+    double maxDiff = 0.0;
+    double sumSq = 0.0;
+    double maxValue = 0.0;
+    for (size_t i = 0; i < a.size(); i++) {
+        double d = std::fabs((double)a[i] - b[i]);
+        maxDiff = std::max(maxDiff, d);
+        sumSq += d * d;
+        maxValue = std::max(maxValue, (double)std::fabs(a[i]));
+    }
+    std::cout << name << ": max |diff| " << maxDiff << ", rms " << std::sqrt(sumSq / a.size())
+        << " (max |value| " << maxValue << ")" << std::endl;
+}
+
+// Runs the GPU and CPU backends side by side from the same initial state
+static int runComparison(const Options& options) {
+    if (const char* option = cpuUnsupportedOption(options, true)) {
+        std::cout << option << " is not supported by --compare, which runs Jacobi sweeps on both backends" << std::endl;
+        return -1;
+    }
+
+    HeadlessContext context;
+    if (!context.initialize()) {
+        std::cout << "Failed to create headless context" << std::endl;
+        return -1;
+    }
+
+    PressurePath pressurePath;
+    if (!parsePressurePath(options.pressurePath, pressurePath)) {
+        std::cout << "Unknown pressure path: " << options.pressurePath << std::endl;
+        return -1;
+    }
+
+    FluidSimulation gpuSim(options.gridSize, options.gridSize);
+    gpuSim.setPressurePath(pressurePath);
+    gpuSim.setFusedPasses(options.fusedPasses);
+    CpuFluidSimulation cpuSim(options.gridSize, options.gridSize, options.threads);
+    if (options.iterations > 0) {
+        gpuSim.setPressureIterations(options.iterations);
+        cpuSim.setPressureIterations(options.iterations);
+    }
+    FluidSolver* solvers[2] = { &gpuSim, &cpuSim };
+
+    const float dt = 0.016f;
+    for (FluidSolver* solver : solvers) {
+        solver->init();
+        solver->addForce(0.5f, 0.5f, 1.0f, 0.5f);
+        solver->addDye(0.5f, 0.5f, 0.8f, 0.4f, 0.2f);
+        for (int i = 0; i < options.steps; i++) {
+            solver->step(dt);
+        }
+    }
+
+    std::cout << "GPU Jacobi pressure path: " << (gpuSim.isUsingComputeShaders() ? "compute" : "fragment") << std::endl;
+    std::vector<float> gpuField, cpuField;
+    gpuSim.readVelocity(gpuField);
+    cpuSim.readVelocity(cpuField);
+    reportDifference("Velocity", gpuField, cpuField);
+    gpuSim.readDye(gpuField);
+    cpuSim.readDye(cpuField);
+    reportDifference("Dye", gpuField, cpuField);
+    return 0;
+}
+
+// Runs each reduced-precision storage profile from the same initial state as
+// an fp32 run and reports the field differences, step time and field memory
+static int runPrecisionComparison(const Options& options) {
+    HeadlessContext context;
+    if (!context.initialize()) {
+        std::cout << "Failed to create headless context" << std::endl;
+        return -1;
+    }
+
+    PressurePath pressurePath;
+    if (!parsePressurePath(options.pressurePath, pressurePath)) {
+        std::cout << "Unknown pressure path: " << options.pressurePath << std::endl;
+        return -1;
+    }
+
+    struct Profile {
+        const char* name;
+        FieldPrecision precision;
+    };
+    const Profile profiles[] = {
+        { "full", FieldPrecision::Full },
+        { "half", FieldPrecision::Half },
+        { "packed", FieldPrecision::Packed }
+    };
+
+    const float dt = 0.016f;
+    std::vector<float> referenceVelocity, referenceDye;
+    std::vector<float> velocity, dye;
+    for (const Profile& profile : profiles) {
+        FluidSimulation sim(options.gridSize, options.gridSize);
+        sim.setPressurePath(pressurePath);
+        sim.setFusedPasses(options.fusedPasses);
+        sim.setFieldPrecision(profile.precision);
+        sim.init();
+        sim.addForce(0.5f, 0.5f, 1.0f, 0.5f);
+        sim.addDye(0.5f, 0.5f, 0.8f, 0.4f, 0.2f);
+
+        // The first step also pays for the drivers' lazy shader work
+        sim.step(dt);
+        sim.finish();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 1; i < options.steps; i++) {
+            sim.step(dt);
+        }
+        sim.finish();
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << std::left << std::setw(7) << profile.name << std::right
+            << (milliseconds / std::max(options.steps - 1, 1)) << " ms/step, "
+            << (sim.getFieldMemory() / (1024.0 * 1024.0)) << " MiB of fields" << std::endl;
+        sim.readVelocity(velocity);
+        sim.readDye(dye);
+        if (profile.precision == FieldPrecision::Full) {
+            referenceVelocity.swap(velocity);
+            referenceDye.swap(dye);
+        }
+        else {
+            reportDifference("  Velocity vs full", velocity, referenceVelocity);
+            reportDifference("  Dye vs full", dye, referenceDye);
+        }
+    }
+    return 0;
+}
+
+// Advances a splatted flow for the requested number of steps, then solves its
+// pressure from zero with each solver and reports residual reduction per
+// millisecond
+static int runPressureBenchmark(const Options& options) {
+    HeadlessContext context;
+    if (!context.initialize()) {
+        std::cout << "Failed to create headless context" << std::endl;
+        return -1;
+    }
+
+    PressurePath pressurePath;
+    if (!parsePressurePath(options.pressurePath, pressurePath)) {
+        std::cout << "Unknown pressure path: " << options.pressurePath << std::endl;
+        return -1;
+    }
+
+    FluidSimulation sim(options.gridSize, options.gridSize);
+    sim.setPressurePath(pressurePath);
+    sim.init();
+    sim.addForce(0.5f, 0.5f, 1.0f, 0.5f);
+    sim.addDye(0.5f, 0.5f, 0.8f, 0.4f, 0.2f);
+    for (int i = 0; i < options.steps; i++) {
+        sim.step(0.016f);
+    }
+    if (options.iterations > 0) {
+        sim.setPressureIterations(options.iterations);
+    }
+
+    struct Entry {
+        const char* name;
+        PressureSolver solver;
+        int iterations;
+    };
+    const Entry entries[] = {
+        { "jacobi", PressureSolver::Jacobi, sim.getPressureIterations() },
+        { "sor", PressureSolver::RedBlackSOR, sim.getPressureIterations() },
+        { "chebyshev", PressureSolver::ChebyshevJacobi, sim.getPressureIterations() },
+        { "multigrid", PressureSolver::Multigrid, sim.getMultigridSettings().cycles }
+    };
+
+    std::cout << "Pressure solve from zero at " << options.gridSize << "x" << options.gridSize
+        << " after " << options.steps << " steps" << std::endl;
+    for (const Entry& entry : entries) {
+        // The first run also pays for shader warm-up and multigrid allocation
+        sim.measurePressureConvergence(entry.solver, entry.iterations);
+        PressureConvergence convergence = sim.measurePressureConvergence(entry.solver, entry.iterations);
+        std::cout << std::left << std::setw(10) << entry.name << std::right
+            << std::setw(4) << convergence.iterations << " iterations "
+            << std::setw(10) << convergence.milliseconds << " ms  residual "
+            << convergence.initialResidual << " -> " << convergence.finalResidual
+            << "  (" << convergence.decadesPerMillisecond() << " decades/ms)" << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            options.headless = true;
+        }
+        else if (strcmp(argv[i], "--compare") == 0) {
+            options.compare = true;
+        }
+        else if (strcmp(argv[i], "--fused-passes") == 0) {
+            options.fusedPasses = true;
+        }
+        else if (strcmp(argv[i], "--pressure-benchmark") == 0) {
+            options.pressureBenchmark = true;
+        }
+        else if (strcmp(argv[i], "--precision-compare") == 0) {
+            options.precisionCompare = true;
+        }
+        else if (strcmp(argv[i], "--precision") == 0 && i + 1 < argc) {
+            options.precision = argv[++i];
+        }
+        else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            options.backend = argv[++i];
+        }
+        else if (strcmp(argv[i], "--solver") == 0 && i + 1 < argc) {
+            options.solver = argv[++i];
+        }
+        else if (strcmp(argv[i], "--warm-start") == 0 && i + 1 < argc) {
+            options.warmStart = argv[++i];
+        }
+        else if (strcmp(argv[i], "--shader-cache") == 0 && i + 1 < argc) {
+            options.shaderCache = argv[++i];
+        }
+        else if (strcmp(argv[i], "--no-shader-cache") == 0) {
+            options.shaderCache.clear();
+        }
+        else if (strcmp(argv[i], "--pressure-path") == 0 && i + 1 < argc) {
+            options.pressurePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            options.tolerance = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+            options.steps = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--grid") == 0 && i + 1 < argc) {
+            options.gridSize = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--dye-grid") == 0 && i + 1 < argc) {
+            options.dyeGridSize = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--step-budget") == 0 && i + 1 < argc) {
+            options.stepBudget = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            options.iterations = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--sim-rate") == 0 && i + 1 < argc) {
+            options.simulationRate = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--cfl") == 0 && i + 1 < argc) {
+            options.courant = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--profile") == 0) {
+            options.profile = true;
+        }
+        else if (strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc) {
+            options.profile = true;
+            options.profileCsv = argv[++i];
+        }
+        else if (strcmp(argv[i], "--frame-budget") == 0 && i + 1 < argc) {
+            options.frameBudget = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--frame-csv") == 0 && i + 1 < argc) {
+            options.frameCsv = argv[++i];
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options.trace = argv[++i];
+        }
+        else if (strcmp(argv[i], "--sparse") == 0) {
+            options.sparse = true;
+        }
+        else if (strcmp(argv[i], "--sparse-threshold") == 0 && i + 1 < argc) {
+            options.sparse = true;
+            options.sparseThreshold = (float)atof(argv[++i]);
+        }
+        else {
+            std::cout << "Usage: " << argv[0]
+                << " [--headless] [--backend gpu|cpu] [--solver jacobi|sor|chebyshev|multigrid]"
+                << " [--tolerance T] [--warm-start zero|previous|extrapolate] [--pressure-path auto|compute|fragment]"
+                << " [--fused-passes] [--precision full|half|packed] [--compare] [--precision-compare] [--pressure-benchmark] [--shader-cache DIR | --no-shader-cache]"
+                << " [--steps N] [--grid N] [--dye-grid N] [--step-budget MS] [--threads N] [--iterations N] [--sim-rate HZ] [--cfl C] [--sparse] [--sparse-threshold U] [--profile] [--profile-csv FILE] [--trace FILE] [--frame-budget MS] [--frame-csv FILE]" << std::endl;
+            return -1;
+        }
+    }
+
+    if (options.gridSize <= 0) {
+        std::cout << "The grid size must be positive" << std::endl;
+        return -1;
+    }
+    if (options.dyeGridSize < 0) {
+        std::cout << "The dye grid size must not be negative" << std::endl;
+        return -1;
+    }
+
+    ShaderCache::setDirectory(options.shaderCache);
+    TRACE_THREAD_NAME("main");
+    if (!options.trace.empty()) {
+        if (Trace::enabled) {
+            Trace::setOutputPath(options.trace);
+        }
+        else {
+            std::cout << "Tracing is compiled out; rebuild with FLUID_ENABLE_TRACING defined to use --trace" << std::endl;
+        }
+    }
+
+    if (options.compare) {
+        return runComparison(options);
+    }
+    if (options.pressureBenchmark) {
+        return runPressureBenchmark(options);
+    }
+    if (options.precisionCompare) {
+        return runPrecisionComparison(options);
+    }
+    if (options.headless) {
+        return runHeadless(options);
+    }
+    if (options.backend != "gpu") {
+        std::cout << "The " << options.backend << " backend is only available with --headless" << std::endl;
+        return -1;
+    }
+
+    if (options.simulationRate <= 0.0) {
+        std::cout << "The simulation rate must be positive" << std::endl;
+        return -1;
+    }
 
-int main() {
     Application app(800, 800, "GPU Fluid Simulation");
+    PressureOptions pressure;
+    if (!parsePressureOptions(options, pressure)) {
+        return -1;
+    }
+    app.setPressureOptions(pressure);
+    app.setFusedPasses(options.fusedPasses);
+    app.setSimulationRate(options.simulationRate);
+    app.setCourantNumber(options.courant);
+    app.setDyeResolution(options.dyeGridSize);
+    app.setGridSize(options.gridSize);
+    FieldPrecision precision;
+    if (!parseFieldPrecision(options.precision, precision)) {
+        std::cout << "Unknown precision: " << options.precision << std::endl;
+        return -1;
+    }
+    app.setFieldPrecision(precision);
+    app.setStepBudget(options.stepBudget);
+    app.setSparseSettings(sparseSettings(options));
+    app.setProfiling(options.profile, options.profileCsv);
+    app.setFrameBudget(options.frameBudget);
+    app.setFrameCsv(options.frameCsv);
 
     if (!app.initialize()) {
         std::cout << "Failed to initialize application" << std::endl;
@@ -1,66 +1,174 @@
 #include "Shader.h"
+#include "GLExtensions.h"
+#include "ShaderCache.h"
+#include "Trace.h"
 #include <iostream>
 
-Shader::Shader(const char* vertexSource, const char* fragmentSource) {
-    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
-    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
-    program = linkProgram(vertexShader, fragmentShader);
+Shader::Shader(const char* vertexSource, const char* fragmentSource)
+    : finished(false) {
+    TRACE_ZONE("submit shader build");
+    const char* sources[2] = { vertexSource, fragmentSource };
+    program = ShaderCache::load(sources, 2);
+    if (!program) {
+        GLuint shaders[2] = {
+            compileShader(GL_VERTEX_SHADER, vertexSource),
+            compileShader(GL_FRAGMENT_SHADER, fragmentSource)
+        };
+        program = linkProgram(shaders, 2);
+        pendingShaders.assign(shaders, shaders + 2);
+        pendingSources.assign(sources, sources + 2);
+    }
+}
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+Shader::Shader(const char* computeSource)
+    : finished(false) {
+    TRACE_ZONE("submit shader build");
+    program = ShaderCache::load(&computeSource, 1);
+    if (!program) {
+        GLuint shader = compileShader(GL_COMPUTE_SHADER, computeSource);
+        program = linkProgram(&shader, 1);
+        pendingShaders.push_back(shader);
+        pendingSources.push_back(computeSource);
+    }
 }
 
 Shader::~Shader() {
+    for (GLuint shader : pendingShaders) {
+        glDeleteShader(shader);
+    }
     glDeleteProgram(program);
 }
 
+void Shader::finish() {
+    if (finished) return;
+    finished = true;
+    TRACE_ZONE("finish shader build");
+
+    if (!pendingShaders.empty()) {
+        // The first status query waits for this program's compile and link
+        bool compiled = true;
+        for (GLuint shader : pendingShaders) {
+            GLint success;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if (!success) {
+                char infoLog[512];
+                glGetShaderInfoLog(shader, 512, NULL, infoLog);
+                std::cout << "Shader compilation failed: " << infoLog << std::endl;
+                compiled = false;
+            }
+        }
+
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success && compiled) {
+            char infoLog[512];
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
+            std::cout << "Program linking failed: " << infoLog << std::endl;
+        }
+
+        std::vector<const char*> sources;
+        for (const std::string& source : pendingSources) {
+            sources.push_back(source.c_str());
+        }
+        ShaderCache::store(sources.data(), (int)sources.size(), program);
+
+        for (GLuint shader : pendingShaders) {
+            glDeleteShader(shader);
+        }
+        pendingShaders.clear();
+        pendingSources.clear();
+    }
+    cacheUniformLocations();
+}
+
 void Shader::use() const {
     glUseProgram(program);
 }
 
+GLint Shader::getUniformLocation(const char* name) const {
+    auto it = uniformLocations.find(name);
+    return it != uniformLocations.end() ? it->second : -1;
+}
+
 void Shader::setInt(const char* name, int value) const {
-    glUniform1i(glGetUniformLocation(program, name), value);
+    glUniform1i(getUniformLocation(name), value);
 }
 
 void Shader::setFloat(const char* name, float value) const {
-    glUniform1f(glGetUniformLocation(program, name), value);
+    glUniform1f(getUniformLocation(name), value);
 }
 
 void Shader::setVec2(const char* name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(program, name), x, y);
+    glUniform2f(getUniformLocation(name), x, y);
 }
 
 void Shader::setVec3(const char* name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(program, name), x, y, z);
+    glUniform3f(getUniformLocation(name), x, y, z);
+}
+
+void Shader::setIVec2(const char* name, int x, int y) const {
+    glUniform2i(getUniformLocation(name), x, y);
+}
+
+void Shader::setInt(GLint location, int value) const {
+    glUniform1i(location, value);
+}
+
+void Shader::setFloat(GLint location, float value) const {
+    glUniform1f(location, value);
+}
+
+void Shader::bindSamplers(std::initializer_list<const char*> names) const {
+    use();
+    int unit = 0;
+    for (const char* name : names) {
+        glUniform1i(getUniformLocation(name), unit++);
+    }
+}
+
+void Shader::bindUniformBlock(const char* name, GLuint binding) const {
+    GLuint index = glGetUniformBlockIndex(program, name);
+    if (index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, index, binding);
+    }
+}
+
+void Shader::cacheUniformLocations() {
+    GLint count = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    for (GLint i = 0; i < count; i++) {
+        char name[256];
+        GLsizei length = 0;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program, (GLuint)i, sizeof(name), &length, &size, &type, name);
+        // Uniforms inside blocks have no location and are skipped
+        GLint location = glGetUniformLocation(program, name);
+        if (location < 0) continue;
+        std::string key(name, length);
+        // Arrays are reported as "name[0]"
+        if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0) {
+            key.resize(key.size() - 3);
+        }
+        uniformLocations[key] = location;
+    }
 }
 
 GLuint Shader::compileShader(GLenum type, const char* source) {
     GLuint shader = glCreateShader(type);
     glShaderSource(shader, 1, &source, NULL);
     glCompileShader(shader);
-
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(shader, 512, NULL, infoLog);
-        std::cout << "Shader compilation failed: " << infoLog << std::endl;
-    }
     return shader;
 }
 
-GLuint Shader::linkProgram(GLuint vertexShader, GLuint fragmentShader) {
+GLuint Shader::linkProgram(const GLuint* shaders, int count) {
     GLuint prog = glCreateProgram();
-    glAttachShader(prog, vertexShader);
-    glAttachShader(prog, fragmentShader);
-    glLinkProgram(prog);
-
-    GLint success;
-    glGetProgramiv(prog, GL_LINK_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(prog, 512, NULL, infoLog);
-        std::cout << "Program linking failed: " << infoLog << std::endl;
+    for (int i = 0; i < count; i++) {
+        glAttachShader(prog, shaders[i]);
     }
+    if (ShaderCache::isEnabled()) {
+        glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(prog);
     return prog;
 }
\ No newline at end of file
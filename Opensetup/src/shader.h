@@ -2,24 +2,58 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include <initializer_list>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+// The constructors only submit the compile and link (or load a cached
+// binary); finish() checks the result and must be called before the program
+// is used. Creating several programs before finishing any lets the driver
+// build them in the background, on several threads where it supports
+// KHR_parallel_shader_compile.
 class Shader {
 public:
     GLuint program;
 
     Shader(const char* vertexSource, const char* fragmentSource);
+    // Compute program; needs a GL 4.3 context (see GLExtensions)
+    explicit Shader(const char* computeSource);
     ~Shader();
 
+    // Waits for the build, reports errors, stores the binary in the
+    // ShaderCache and resolves uniform locations. Does nothing if called again.
+    void finish();
+
     void use() const;
+    // Uniform locations are resolved once after linking; -1 if the program
+    // has no active uniform of that name. Hot loops should keep the
+    // location and use the overloads that take it.
+    GLint getUniformLocation(const char* name) const;
     void setInt(const char* name, int value) const;
     void setFloat(const char* name, float value) const;
     void setVec2(const char* name, float x, float y) const;
     void setVec3(const char* name, float x, float y, float z) const;
+    void setIVec2(const char* name, int x, int y) const;
+    void setInt(GLint location, int value) const;
+    void setFloat(GLint location, float value) const;
+
+    // Assigns texture units 0, 1, ... to the named samplers in order. The
+    // program keeps them, so passes only need to bind textures.
+    void bindSamplers(std::initializer_list<const char*> names) const;
+    // Connects a uniform block to a GL_UNIFORM_BUFFER binding point
+    void bindUniformBlock(const char* name, GLuint binding) const;
 
 private:
+    std::unordered_map<std::string, GLint> uniformLocations;
+    bool finished;
+    // Shader objects and sources of a build that has not been checked yet
+    std::vector<GLuint> pendingShaders;
+    std::vector<std::string> pendingSources;
+
     GLuint compileShader(GLenum type, const char* source);
-    GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader);
+    GLuint linkProgram(const GLuint* shaders, int count);
+    void cacheUniformLocations();
 };
 
 #endif
\ No newline at end of file